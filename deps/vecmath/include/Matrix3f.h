@@ -2,10 +2,12 @@
 #define MATRIX3F_H
 
 #include <cstdio>
+#include <cstring>
+
+#include "Vector3f.h"
 
 class Matrix2f;
 class Quat4f;
-class Vector3f;
 
 // 3x3 Matrix, stored in column major order (OpenGL style)
 class Matrix3f {
@@ -79,4 +81,153 @@ Vector3f operator*(const Matrix3f& m, const Vector3f& v);
 // Matrix-Matrix multiplication
 Matrix3f operator*(const Matrix3f& x, const Matrix3f& y);
 
+// Inline, so that the arithmetic of the callers compiles straight through
+
+inline Matrix3f::Matrix3f(double fill) {
+    for (int i = 0; i < 9; ++i)
+        m_elements[i] = fill;
+}
+
+inline Matrix3f::Matrix3f(double m00, double m01, double m02,
+                   double m10, double m11, double m12,
+                   double m20, double m21, double m22) {
+    m_elements[0] = m00;
+    m_elements[1] = m10;
+    m_elements[2] = m20;
+
+    m_elements[3] = m01;
+    m_elements[4] = m11;
+    m_elements[5] = m21;
+
+    m_elements[6] = m02;
+    m_elements[7] = m12;
+    m_elements[8] = m22;
+}
+
+inline Matrix3f::Matrix3f(const Vector3f& v0, const Vector3f& v1, const Vector3f& v2, bool setColumns) {
+    if (setColumns) {
+        setCol(0, v0);
+        setCol(1, v1);
+        setCol(2, v2);
+    } else {
+        setRow(0, v0);
+        setRow(1, v1);
+        setRow(2, v2);
+    }
+}
+
+inline Matrix3f::Matrix3f(const Matrix3f& rm) {
+    memcpy(m_elements, rm.m_elements, 9 * sizeof(double));
+}
+
+inline Matrix3f& Matrix3f::operator=(const Matrix3f& rm) {
+    if (this != &rm)
+        memcpy(m_elements, rm.m_elements, 9 * sizeof(double));
+    return *this;
+}
+
+inline const double& Matrix3f::operator()(int i, int j) const {
+    return m_elements[j * 3 + i];
+}
+
+inline double& Matrix3f::operator()(int i, int j) {
+    return m_elements[j * 3 + i];
+}
+
+inline Vector3f Matrix3f::getRow(int i) const {
+    return Vector3f(
+        m_elements[i],
+        m_elements[i + 3],
+        m_elements[i + 6]
+    );
+}
+
+inline void Matrix3f::setRow(int i, const Vector3f& v) {
+    m_elements[i] = v.x();
+    m_elements[i + 3] = v.y();
+    m_elements[i + 6] = v.z();
+}
+
+inline Vector3f Matrix3f::getCol(int j) const {
+    int colStart = 3 * j;
+
+    return Vector3f(
+        m_elements[colStart],
+        m_elements[colStart + 1],
+        m_elements[colStart + 2]            
+    );
+}
+
+inline void Matrix3f::setCol(int j, const Vector3f& v) {
+    int colStart = 3 * j;
+
+    m_elements[colStart] = v.x();
+    m_elements[colStart + 1] = v.y();
+    m_elements[colStart + 2] = v.z();
+}
+
+inline double Matrix3f::determinant() const {
+    return Matrix3f::determinant3x3(
+        m_elements[0], m_elements[3], m_elements[6],
+        m_elements[1], m_elements[4], m_elements[7],
+        m_elements[2], m_elements[5], m_elements[8]
+    );
+}
+
+inline void Matrix3f::transpose() {
+    double temp;
+
+    for (int i = 0; i < 2; ++i)
+        for (int j = i + 1; j < 3; ++j) {
+            temp = (*this)(i, j);
+            (*this)(i, j) = (*this)(j, i);
+            (*this)(j, i) = temp;
+        }
+}
+
+inline Matrix3f Matrix3f::transposed() const {
+    Matrix3f out;
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            out(j, i) = (*this)(i, j);
+
+    return out;
+}
+
+// Static method
+inline double Matrix3f::determinant3x3(double m00, double m01, double m02,
+                               double m10, double m11, double m12,
+                               double m20, double m21, double m22) {
+    return (
+          m00 * (m11 * m22 - m12 * m21)
+        - m01 * (m10 * m22 - m12 * m20)
+        + m02 * (m10 * m21 - m11 * m20)
+    );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Operators
+//////////////////////////////////////////////////////////////////////////
+inline 
+Vector3f operator*(const Matrix3f& m, const Vector3f& v) {
+    Vector3f output(0, 0, 0);
+
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            output[i] += m(i, j) * v[j];
+
+    return output;
+}
+
+inline Matrix3f operator*(const Matrix3f& x, const Matrix3f& y) {
+    Matrix3f product; // Zeroes
+
+    for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+            for (int k = 0; k < 3; ++k)
+                product(i, k) += x(i, j) * y(j, k);
+
+    return product;
+}
+
 #endif // MATRIX3F_H
@@ -1,6 +1,8 @@
 #ifndef VECTOR_3F_H
 #define VECTOR_3F_H
 
+#include <cmath>
+
 class Vector2f;
 
 class Vector3f {
@@ -96,4 +98,199 @@ Vector3f operator/(const Vector3f& v, double f);
 bool operator==(const Vector3f& v0, const Vector3f& v1);
 bool operator!=(const Vector3f& v0, const Vector3f& v1);
 
+// Inline, so that the arithmetic of the callers compiles straight through
+
+inline Vector3f::Vector3f(double f) {
+    m_elements[0] = f;
+    m_elements[1] = f;
+    m_elements[2] = f;
+}
+
+inline Vector3f::Vector3f(double x, double y, double z) {
+    m_elements[0] = x;
+    m_elements[1] = y;
+    m_elements[2] = z;
+}
+
+inline Vector3f::Vector3f(const Vector3f& rv) {
+    m_elements[0] = rv[0];
+    m_elements[1] = rv[1];
+    m_elements[2] = rv[2];
+}
+
+inline Vector3f& Vector3f::operator=(const Vector3f& rv) {
+    if (this != &rv) {
+        m_elements[0] = rv[0];
+        m_elements[1] = rv[1];
+        m_elements[2] = rv[2];
+    }
+    return *this;
+}
+
+inline const double& Vector3f::operator[](int i) const {
+    return m_elements[i];
+}
+
+inline double& Vector3f::operator[](int i) {
+    return m_elements[i];
+}
+
+inline double& Vector3f::x() {
+    return m_elements[0];
+}
+
+inline double& Vector3f::y() {
+    return m_elements[1];
+}
+
+inline double& Vector3f::z() {
+    return m_elements[2];
+}
+
+inline double Vector3f::x() const {
+    return m_elements[0];
+}
+
+inline double Vector3f::y() const {
+    return m_elements[1];
+}
+
+inline double Vector3f::z() const {
+    return m_elements[2];
+}
+
+inline Vector3f Vector3f::xyz() const {
+    return Vector3f(m_elements[0], m_elements[1], m_elements[2]);
+}
+
+inline Vector3f Vector3f::yzx() const {
+    return Vector3f(m_elements[1], m_elements[2], m_elements[0]);
+}
+
+inline Vector3f Vector3f::zxy() const {
+    return Vector3f(m_elements[2], m_elements[0], m_elements[1]);
+}
+
+inline double Vector3f::length() const {
+    return sqrt(m_elements[0] * m_elements[0] + m_elements[1] * m_elements[1] + m_elements[2] * m_elements[2]);
+}
+
+inline double Vector3f::squaredLength() const {
+    return (
+        m_elements[0] * m_elements[0] +
+        m_elements[1] * m_elements[1] +
+        m_elements[2] * m_elements[2]
+    );
+}
+
+inline void Vector3f::normalize() {
+    double norm = length();
+    m_elements[0] /= norm;
+    m_elements[1] /= norm;
+    m_elements[2] /= norm;
+}
+
+inline Vector3f Vector3f::normalized() const {
+    double norm = length();
+    return Vector3f(
+        m_elements[0] / norm,
+        m_elements[1] / norm,
+        m_elements[2] / norm
+    );
+}
+
+inline void Vector3f::negate() {
+    m_elements[0] = -m_elements[0];
+    m_elements[1] = -m_elements[1];
+    m_elements[2] = -m_elements[2];
+}
+
+inline Vector3f::operator const double*() const {
+    return m_elements;
+}
+
+inline Vector3f::operator double*() {
+    return m_elements;
+}
+
+inline Vector3f& Vector3f::operator+=(const Vector3f& v) {
+    m_elements[0] += v.m_elements[0];
+    m_elements[1] += v.m_elements[1];
+    m_elements[2] += v.m_elements[2];
+    return *this;
+}
+
+inline Vector3f& Vector3f::operator-=(const Vector3f& v) {
+    m_elements[0] -= v.m_elements[0];
+    m_elements[1] -= v.m_elements[1];
+    m_elements[2] -= v.m_elements[2];
+    return *this;
+}
+
+inline Vector3f& Vector3f::operator*=(double f) {
+    m_elements[0] *= f;
+    m_elements[1] *= f;
+    m_elements[2] *= f;
+    return *this;
+}
+
+// Static method
+inline double Vector3f::dot(const Vector3f& v0, const Vector3f& v1) {
+    return v0[0] * v1[0] + v0[1] * v1[1] + v0[2] * v1[2];
+}
+
+// Static method
+inline Vector3f Vector3f::cross(const Vector3f& v0, const Vector3f& v1) {
+    return Vector3f(
+        v0.y() * v1.z() - v0.z() * v1.y(),
+        v0.z() * v1.x() - v0.x() * v1.z(),
+        v0.x() * v1.y() - v0.y() * v1.x()
+    );
+}
+
+// Static method
+inline Vector3f Vector3f::lerp(const Vector3f& v0, const Vector3f& v1, double alpha) {
+    return alpha * (v1 - v0) + v0;
+}
+
+inline Vector3f operator+(const Vector3f& v0, const Vector3f& v1) {
+    return Vector3f(v0[0] + v1[0], v0[1] + v1[1], v0[2] + v1[2]);
+}
+
+inline Vector3f operator-(const Vector3f& v0, const Vector3f& v1) {
+    return Vector3f(v0[0] - v1[0], v0[1] - v1[1], v0[2] - v1[2]);
+}
+
+inline Vector3f operator*(const Vector3f& v0, const Vector3f& v1) {
+    return Vector3f(v0[0] * v1[0], v0[1] * v1[1], v0[2] * v1[2]);
+}
+
+inline Vector3f operator/(const Vector3f& v0, const Vector3f& v1) {
+    return Vector3f(v0[0] / v1[0], v0[1] / v1[1], v0[2] / v1[2]);
+}
+
+inline Vector3f operator-(const Vector3f& v) {
+    return Vector3f(-v[0], -v[1], -v[2]);
+}
+
+inline Vector3f operator*(double f, const Vector3f& v) {
+    return Vector3f(v[0] * f, v[1] * f, v[2] * f);
+}
+
+inline Vector3f operator*(const Vector3f& v, double f) {
+    return Vector3f(v[0] * f, v[1] * f, v[2] * f);
+}
+
+inline Vector3f operator/(const Vector3f& v, double f) {
+    return Vector3f(v[0] / f, v[1] / f, v[2] / f);
+}
+
+inline bool operator==(const Vector3f& v0, const Vector3f& v1) {
+    return (v0.x() == v1.x() && v0.y() == v1.y() && v0.z() == v1.z());
+}
+
+inline bool operator!=(const Vector3f& v0, const Vector3f& v1) {
+    return !(v0 == v1);
+}
+
 #endif // VECTOR_3F_H
@@ -1,8 +1,11 @@
 #ifndef VECTOR_4F_H
 #define VECTOR_4F_H
 
+#include <cmath>
+
+#include "Vector3f.h"
+
 class Vector2f;
-class Vector3f;
 
 class Vector4f {
 public:
@@ -95,4 +98,252 @@ Vector4f operator/(const Vector4f& v, double f);
 bool operator==(const Vector4f& v0, const Vector4f& v1);
 bool operator!=(const Vector4f& v0, const Vector4f& v1);
 
+// Inline, so that the arithmetic of the callers compiles straight through
+
+inline Vector4f::Vector4f(double f) {
+    m_elements[0] = f;
+    m_elements[1] = f;
+    m_elements[2] = f;
+    m_elements[3] = f;
+}
+
+inline Vector4f::Vector4f(double fx, double fy, double fz, double fw) {
+    m_elements[0] = fx;
+    m_elements[1] = fy;
+    m_elements[2] = fz;
+    m_elements[3] = fw;
+}
+
+inline Vector4f::Vector4f(double buffer[4]) {
+    m_elements[0] = buffer[0];
+    m_elements[1] = buffer[1];
+    m_elements[2] = buffer[2];
+    m_elements[3] = buffer[3];
+}
+
+inline Vector4f::Vector4f(const Vector3f& xyz, double w) {
+    m_elements[0] = xyz.x();
+    m_elements[1] = xyz.y();
+    m_elements[2] = xyz.z();
+    m_elements[3] = w;
+}
+
+inline Vector4f::Vector4f(double x, const Vector3f& yzw) {
+    m_elements[0] = x;
+    m_elements[1] = yzw.x();
+    m_elements[2] = yzw.y();
+    m_elements[3] = yzw.z();
+}
+
+inline Vector4f::Vector4f(const Vector4f& rv) {
+    m_elements[0] = rv.m_elements[0];
+    m_elements[1] = rv.m_elements[1];
+    m_elements[2] = rv.m_elements[2];
+    m_elements[3] = rv.m_elements[3];
+}
+
+inline Vector4f& Vector4f::operator=(const Vector4f& rv) {
+    if (this != &rv) {
+        m_elements[0] = rv.m_elements[0];
+        m_elements[1] = rv.m_elements[1];
+        m_elements[2] = rv.m_elements[2];
+        m_elements[3] = rv.m_elements[3];
+    }
+    return *this;
+}
+
+inline const double& Vector4f::operator[](int i) const {
+    return m_elements[i];
+}
+
+inline double& Vector4f::operator[](int i) {
+    return m_elements[i];
+}
+
+inline double& Vector4f::x() {
+    return m_elements[0];
+}
+
+inline double& Vector4f::y() {
+    return m_elements[1];
+}
+
+inline double& Vector4f::z() {
+    return m_elements[2];
+}
+
+inline double& Vector4f::w() {
+    return m_elements[3];
+}
+
+inline double Vector4f::x() const {
+    return m_elements[0];
+}
+
+inline double Vector4f::y() const {
+    return m_elements[1];
+}
+
+inline double Vector4f::z() const {
+    return m_elements[2];
+}
+
+inline double Vector4f::w() const {
+    return m_elements[3];
+}
+
+inline Vector3f Vector4f::xyz() const {
+    return Vector3f(m_elements[0], m_elements[1], m_elements[2]);
+}
+
+inline Vector3f Vector4f::yzw() const {
+    return Vector3f(m_elements[1], m_elements[2], m_elements[3]);
+}
+
+inline Vector3f Vector4f::zwx() const {
+    return Vector3f(m_elements[2], m_elements[3], m_elements[0]);
+}
+
+inline Vector3f Vector4f::wxy() const {
+    return Vector3f(m_elements[3], m_elements[0], m_elements[1]);
+}
+
+inline Vector3f Vector4f::xyw() const {
+    return Vector3f(m_elements[0], m_elements[1], m_elements[3]);
+}
+
+inline Vector3f Vector4f::yzx() const {
+    return Vector3f(m_elements[1], m_elements[2], m_elements[0]);
+}
+
+inline Vector3f Vector4f::zwy() const {
+    return Vector3f(m_elements[2], m_elements[3], m_elements[1]);
+}
+
+inline Vector3f Vector4f::wxz() const {
+    return Vector3f(m_elements[3], m_elements[0], m_elements[2]);
+}
+
+inline double Vector4f::abs() const {
+    return sqrt(m_elements[0] * m_elements[0] + m_elements[1] * m_elements[1] + m_elements[2] * m_elements[2] + m_elements[3] * m_elements[3]);
+}
+
+inline double Vector4f::absSquared() const {
+    return (m_elements[0] * m_elements[0] + m_elements[1] * m_elements[1] + m_elements[2] * m_elements[2] + m_elements[3] * m_elements[3]);
+}
+
+inline void Vector4f::normalize() {
+    double norm = sqrt(m_elements[0] * m_elements[0] + m_elements[1] * m_elements[1] + m_elements[2] * m_elements[2] + m_elements[3] * m_elements[3]);
+    m_elements[0] = m_elements[0] / norm;
+    m_elements[1] = m_elements[1] / norm;
+    m_elements[2] = m_elements[2] / norm;
+    m_elements[3] = m_elements[3] / norm;
+}
+
+inline Vector4f Vector4f::normalized() const {
+    double length = abs();
+    return Vector4f(
+        m_elements[0] / length,
+        m_elements[1] / length,
+        m_elements[2] / length,
+        m_elements[3] / length
+    );
+}
+
+inline void Vector4f::homogenize() {
+    if (m_elements[3] != 0) {
+        m_elements[0] /= m_elements[3];
+        m_elements[1] /= m_elements[3];
+        m_elements[2] /= m_elements[3];
+        m_elements[3] = 1;
+    }
+}
+
+inline Vector4f Vector4f::homogenized() const {
+    if (m_elements[3] != 0) {
+        return Vector4f(
+            m_elements[0] / m_elements[3],
+            m_elements[1] / m_elements[3],
+            m_elements[2] / m_elements[3],
+            1
+        );
+    } else {
+        return Vector4f(
+            m_elements[0],
+            m_elements[1],
+            m_elements[2],
+            m_elements[3]
+        );
+    }
+}
+
+inline void Vector4f::negate() {
+    m_elements[0] = -m_elements[0];
+    m_elements[1] = -m_elements[1];
+    m_elements[2] = -m_elements[2];
+    m_elements[3] = -m_elements[3];
+}
+
+inline Vector4f::operator const double*() const {
+    return m_elements;
+}
+
+inline Vector4f::operator double*() {
+    return m_elements;
+}
+
+// Static method
+inline double Vector4f::dot(const Vector4f& v0, const Vector4f& v1) {
+    return v0.x() * v1.x() + v0.y() * v1.y() + v0.z() * v1.z() + v0.w() * v1.w();
+}
+
+// Static method
+inline Vector4f Vector4f::lerp(const Vector4f& v0, const Vector4f& v1, double alpha) {
+    return alpha * (v1 - v0) + v0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Operators
+//////////////////////////////////////////////////////////////////////////
+inline 
+Vector4f operator+(const Vector4f& v0, const Vector4f& v1) {
+    return Vector4f(v0.x() + v1.x(), v0.y() + v1.y(), v0.z() + v1.z(), v0.w() + v1.w());
+}
+
+inline Vector4f operator-(const Vector4f& v0, const Vector4f& v1) {
+    return Vector4f(v0.x() - v1.x(), v0.y() - v1.y(), v0.z() - v1.z(), v0.w() - v1.w());
+}
+
+inline Vector4f operator*(const Vector4f& v0, const Vector4f& v1) {
+    return Vector4f(v0.x() * v1.x(), v0.y() * v1.y(), v0.z() * v1.z(), v0.w() * v1.w());
+}
+
+inline Vector4f operator/(const Vector4f& v0, const Vector4f& v1) {
+    return Vector4f(v0.x() / v1.x(), v0.y() / v1.y(), v0.z() / v1.z(), v0.w() / v1.w());
+}
+
+inline Vector4f operator-(const Vector4f& v) {
+    return Vector4f(-v.x(), -v.y(), -v.z(), -v.w());
+}
+
+inline Vector4f operator*(double f, const Vector4f& v) {
+    return Vector4f(f * v.x(), f * v.y(), f * v.z(), f * v.w());
+}
+
+inline Vector4f operator*(const Vector4f& v, double f) {
+    return Vector4f(f * v.x(), f * v.y(), f * v.z(), f * v.w());
+}
+
+inline Vector4f operator/(const Vector4f& v, double f) {
+    return Vector4f(v[0] / f, v[1] / f, v[2] / f, v[3] / f);
+}
+
+inline bool operator==(const Vector4f& v0, const Vector4f& v1) {
+    return (v0.x() == v1.x() && v0.y() == v1.y() && v0.z() == v1.z() && v0.w() == v1.w());
+}
+
+inline bool operator!=(const Vector4f& v0, const Vector4f& v1) {
+    return !(v0 == v1);
+}
+
 #endif // VECTOR_4F_H
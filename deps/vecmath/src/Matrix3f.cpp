@@ -9,89 +9,6 @@
 #include "Quat4f.h"
 #include "Vector3f.h"
 
-Matrix3f::Matrix3f(double fill) {
-    for (int i = 0; i < 9; ++i)
-        m_elements[i] = fill;
-}
-
-Matrix3f::Matrix3f(double m00, double m01, double m02,
-                   double m10, double m11, double m12,
-                   double m20, double m21, double m22) {
-    m_elements[0] = m00;
-    m_elements[1] = m10;
-    m_elements[2] = m20;
-
-    m_elements[3] = m01;
-    m_elements[4] = m11;
-    m_elements[5] = m21;
-
-    m_elements[6] = m02;
-    m_elements[7] = m12;
-    m_elements[8] = m22;
-}
-
-Matrix3f::Matrix3f(const Vector3f& v0, const Vector3f& v1, const Vector3f& v2, bool setColumns) {
-    if (setColumns) {
-        setCol(0, v0);
-        setCol(1, v1);
-        setCol(2, v2);
-    } else {
-        setRow(0, v0);
-        setRow(1, v1);
-        setRow(2, v2);
-    }
-}
-
-Matrix3f::Matrix3f(const Matrix3f& rm) {
-    memcpy(m_elements, rm.m_elements, 9 * sizeof(double));
-}
-
-Matrix3f& Matrix3f::operator=(const Matrix3f& rm) {
-    if (this != &rm)
-        memcpy(m_elements, rm.m_elements, 9 * sizeof(double));
-    return *this;
-}
-
-const double& Matrix3f::operator()(int i, int j) const {
-    return m_elements[j * 3 + i];
-}
-
-double& Matrix3f::operator()(int i, int j) {
-    return m_elements[j * 3 + i];
-}
-
-Vector3f Matrix3f::getRow(int i) const {
-    return Vector3f(
-        m_elements[i],
-        m_elements[i + 3],
-        m_elements[i + 6]
-    );
-}
-
-void Matrix3f::setRow(int i, const Vector3f& v) {
-    m_elements[i] = v.x();
-    m_elements[i + 3] = v.y();
-    m_elements[i + 6] = v.z();
-}
-
-Vector3f Matrix3f::getCol(int j) const {
-    int colStart = 3 * j;
-
-    return Vector3f(
-        m_elements[colStart],
-        m_elements[colStart + 1],
-        m_elements[colStart + 2]            
-    );
-}
-
-void Matrix3f::setCol(int j, const Vector3f& v) {
-    int colStart = 3 * j;
-
-    m_elements[colStart] = v.x();
-    m_elements[colStart + 1] = v.y();
-    m_elements[colStart + 2] = v.z();
-}
-
 Matrix2f Matrix3f::getSubmatrix2x2(int i0, int j0) const {
     Matrix2f out;
 
@@ -108,14 +25,6 @@ void Matrix3f::setSubmatrix2x2(int i0, int j0, const Matrix2f& m) {
             (*this)(i + i0, j + j0) = m(i, j);
 }
 
-double Matrix3f::determinant() const {
-    return Matrix3f::determinant3x3(
-        m_elements[0], m_elements[3], m_elements[6],
-        m_elements[1], m_elements[4], m_elements[7],
-        m_elements[2], m_elements[5], m_elements[8]
-    );
-}
-
 Matrix3f Matrix3f::inverse(bool* pbIsSingular, double epsilon) const {
     double m00 = m_elements[0];
     double m10 = m_elements[1];
@@ -162,26 +71,6 @@ Matrix3f Matrix3f::inverse(bool* pbIsSingular, double epsilon) const {
     }
 }
 
-void Matrix3f::transpose() {
-    double temp;
-
-    for (int i = 0; i < 2; ++i)
-        for (int j = i + 1; j < 3; ++j) {
-            temp = (*this)(i, j);
-            (*this)(i, j) = (*this)(j, i);
-            (*this)(j, i) = temp;
-        }
-}
-
-Matrix3f Matrix3f::transposed() const {
-    Matrix3f out;
-    for (int i = 0; i < 3; ++i)
-        for (int j = 0; j < 3; ++j)
-            out(j, i) = (*this)(i, j);
-
-    return out;
-}
-
 Matrix3f::operator double*() {
     return m_elements;
 }
@@ -193,17 +82,6 @@ void Matrix3f::print() {
         m_elements[2], m_elements[5], m_elements[8]);
 }
 
-// Static method
-double Matrix3f::determinant3x3(double m00, double m01, double m02,
-                               double m10, double m11, double m12,
-                               double m20, double m21, double m22) {
-    return (
-          m00 * (m11 * m22 - m12 * m21)
-        - m01 * (m10 * m22 - m12 * m20)
-        + m02 * (m10 * m21 - m11 * m20)
-    );
-}
-
 // Static method
 Matrix3f Matrix3f::ones() {
     Matrix3f m;
@@ -320,28 +198,3 @@ Matrix3f Matrix3f::rotation(const Quat4f& rq) {
         2.0 * (xz - yw),                2.0 * (yz + xw),                1.0 - 2.0 * (xx + yy)
     );
 }
-
-//////////////////////////////////////////////////////////////////////////
-// Operators
-//////////////////////////////////////////////////////////////////////////
-
-Vector3f operator*(const Matrix3f& m, const Vector3f& v) {
-    Vector3f output(0, 0, 0);
-
-    for (int i = 0; i < 3; ++i)
-        for (int j = 0; j < 3; ++j)
-            output[i] += m(i, j) * v[j];
-
-    return output;
-}
-
-Matrix3f operator*(const Matrix3f& x, const Matrix3f& y) {
-    Matrix3f product; // Zeroes
-
-    for (int i = 0; i < 3; ++i)
-        for (int j = 0; j < 3; ++j)
-            for (int k = 0; k < 3; ++k)
-                product(i, k) += x(i, j) * y(j, k);
-
-    return product;
-}
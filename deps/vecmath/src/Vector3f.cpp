@@ -21,18 +21,6 @@ const Vector3f Vector3f::RIGHT = Vector3f(1, 0, 0);
 // Static method
 const Vector3f Vector3f::FORWARD = Vector3f(0, 0, -1);
 
-Vector3f::Vector3f(double f) {
-    m_elements[0] = f;
-    m_elements[1] = f;
-    m_elements[2] = f;
-}
-
-Vector3f::Vector3f(double x, double y, double z) {
-    m_elements[0] = x;
-    m_elements[1] = y;
-    m_elements[2] = z;
-}
-
 Vector3f::Vector3f(const Vector2f& xy, double z) {
     m_elements[0] = xy.x();
     m_elements[1] = xy.y();
@@ -45,53 +33,6 @@ Vector3f::Vector3f(double x, const Vector2f& yz) {
     m_elements[2] = yz.y();
 }
 
-Vector3f::Vector3f(const Vector3f& rv) {
-    m_elements[0] = rv[0];
-    m_elements[1] = rv[1];
-    m_elements[2] = rv[2];
-}
-
-Vector3f& Vector3f::operator=(const Vector3f& rv) {
-    if (this != &rv) {
-        m_elements[0] = rv[0];
-        m_elements[1] = rv[1];
-        m_elements[2] = rv[2];
-    }
-    return *this;
-}
-
-const double& Vector3f::operator[](int i) const {
-    return m_elements[i];
-}
-
-double& Vector3f::operator[](int i) {
-    return m_elements[i];
-}
-
-double& Vector3f::x() {
-    return m_elements[0];
-}
-
-double& Vector3f::y() {
-    return m_elements[1];
-}
-
-double& Vector3f::z() {
-    return m_elements[2];
-}
-
-double Vector3f::x() const {
-    return m_elements[0];
-}
-
-double Vector3f::y() const {
-    return m_elements[1];
-}
-
-double Vector3f::z() const {
-    return m_elements[2];
-}
-
 Vector2f Vector3f::xy() const {
     return Vector2f(m_elements[0], m_elements[1]);
 }
@@ -104,46 +45,6 @@ Vector2f Vector3f::yz() const {
     return Vector2f(m_elements[1], m_elements[2]);
 }
 
-Vector3f Vector3f::xyz() const {
-    return Vector3f(m_elements[0], m_elements[1], m_elements[2]);
-}
-
-Vector3f Vector3f::yzx() const {
-    return Vector3f(m_elements[1], m_elements[2], m_elements[0]);
-}
-
-Vector3f Vector3f::zxy() const {
-    return Vector3f(m_elements[2], m_elements[0], m_elements[1]);
-}
-
-double Vector3f::length() const {
-    return sqrt(m_elements[0] * m_elements[0] + m_elements[1] * m_elements[1] + m_elements[2] * m_elements[2]);
-}
-
-double Vector3f::squaredLength() const {
-    return (
-        m_elements[0] * m_elements[0] +
-        m_elements[1] * m_elements[1] +
-        m_elements[2] * m_elements[2]
-    );
-}
-
-void Vector3f::normalize() {
-    double norm = length();
-    m_elements[0] /= norm;
-    m_elements[1] /= norm;
-    m_elements[2] /= norm;
-}
-
-Vector3f Vector3f::normalized() const {
-    double norm = length();
-    return Vector3f(
-        m_elements[0] / norm,
-        m_elements[1] / norm,
-        m_elements[2] / norm
-    );
-}
-
 Vector2f Vector3f::homogenized() const {
     return Vector2f(
         m_elements[0] / m_elements[2],
@@ -151,65 +52,11 @@ Vector2f Vector3f::homogenized() const {
     );
 }
 
-void Vector3f::negate() {
-    m_elements[0] = -m_elements[0];
-    m_elements[1] = -m_elements[1];
-    m_elements[2] = -m_elements[2];
-}
-
-Vector3f::operator const double*() const {
-    return m_elements;
-}
-
-Vector3f::operator double*() {
-    return m_elements;
-}
-
 void Vector3f::print() const {
     printf("<%.4f, %.4f, %.4f>\n",
         m_elements[0], m_elements[1], m_elements[2]);
 }
 
-Vector3f& Vector3f::operator+=(const Vector3f& v) {
-    m_elements[0] += v.m_elements[0];
-    m_elements[1] += v.m_elements[1];
-    m_elements[2] += v.m_elements[2];
-    return *this;
-}
-
-Vector3f& Vector3f::operator-=(const Vector3f& v) {
-    m_elements[0] -= v.m_elements[0];
-    m_elements[1] -= v.m_elements[1];
-    m_elements[2] -= v.m_elements[2];
-    return *this;
-}
-
-Vector3f& Vector3f::operator*=(double f) {
-    m_elements[0] *= f;
-    m_elements[1] *= f;
-    m_elements[2] *= f;
-    return *this;
-}
-
-// Static method
-double Vector3f::dot(const Vector3f& v0, const Vector3f& v1) {
-    return v0[0] * v1[0] + v0[1] * v1[1] + v0[2] * v1[2];
-}
-
-// Static method
-Vector3f Vector3f::cross(const Vector3f& v0, const Vector3f& v1) {
-    return Vector3f(
-        v0.y() * v1.z() - v0.z() * v1.y(),
-        v0.z() * v1.x() - v0.x() * v1.z(),
-        v0.x() * v1.y() - v0.y() * v1.x()
-    );
-}
-
-// Static method
-Vector3f Vector3f::lerp(const Vector3f& v0, const Vector3f& v1, double alpha) {
-    return alpha * (v1 - v0) + v0;
-}
-
 // Static method
 Vector3f Vector3f::cubicInterpolate(const Vector3f& p0, const Vector3f& p1, const Vector3f& p2, const Vector3f& p3, double t) {
     // Geometric construction:
@@ -229,43 +76,3 @@ Vector3f Vector3f::cubicInterpolate(const Vector3f& p0, const Vector3f& p1, cons
     // Top level
     return Vector3f::lerp(p0p1_p1p2, p1p2_p2p3, t);
 }
-
-Vector3f operator+(const Vector3f& v0, const Vector3f& v1) {
-    return Vector3f(v0[0] + v1[0], v0[1] + v1[1], v0[2] + v1[2]);
-}
-
-Vector3f operator-(const Vector3f& v0, const Vector3f& v1) {
-    return Vector3f(v0[0] - v1[0], v0[1] - v1[1], v0[2] - v1[2]);
-}
-
-Vector3f operator*(const Vector3f& v0, const Vector3f& v1) {
-    return Vector3f(v0[0] * v1[0], v0[1] * v1[1], v0[2] * v1[2]);
-}
-
-Vector3f operator/(const Vector3f& v0, const Vector3f& v1) {
-    return Vector3f(v0[0] / v1[0], v0[1] / v1[1], v0[2] / v1[2]);
-}
-
-Vector3f operator-(const Vector3f& v) {
-    return Vector3f(-v[0], -v[1], -v[2]);
-}
-
-Vector3f operator*(double f, const Vector3f& v) {
-    return Vector3f(v[0] * f, v[1] * f, v[2] * f);
-}
-
-Vector3f operator*(const Vector3f& v, double f) {
-    return Vector3f(v[0] * f, v[1] * f, v[2] * f);
-}
-
-Vector3f operator/(const Vector3f& v, double f) {
-    return Vector3f(v[0] / f, v[1] / f, v[2] / f);
-}
-
-bool operator==(const Vector3f& v0, const Vector3f& v1) {
-    return (v0.x() == v1.x() && v0.y() == v1.y() && v0.z() == v1.z());
-}
-
-bool operator!=(const Vector3f& v0, const Vector3f& v1) {
-    return !(v0 == v1);
-}
@@ -50,43 +50,28 @@ public:
                 return false;
 
             Vector3f position = ray.at(tmax / length);
-            Vector3f normal;
-
-            for (int i = 0; i < 3; i++) {
-                if (maxIdx != i) {
-                    if (position[i] < LLB[i] || position[i] > URF[i])
-                        return false;
-                    else { }
-                } else {
-                    normal[i] = (pos[i] == RIGHT)? 1 : -1;
-                }
-            }
 
-            hit.set(tmax / length, nullptr, {position, normal});
+            for (int i = 0; i < 3; i++)
+                if (maxIdx != i && (position[i] < LLB[i] || position[i] > URF[i]))
+                    return false;
+
+            hit.record(tmax / length, nullptr, nullptr); // Only t is read, no surface
             return true;
         } else {
             double t = INFINITY;
-            int minIdx = 0;
             for (int i = 0; i < 3; i++)
                 if (std::abs(dir[i]) > 1e-6 && (candidate[i] - origin[i]) / dir[i] >= 0)
-                    if (t > (candidate[i] - origin[i]) / dir[i]) {
-                        t = (candidate[i] - origin[i]) / dir[i];
-                        minIdx = i;
-                    }
+                    t = std::min(t, (candidate[i] - origin[i]) / dir[i]);
 
             if (t / length < tmin || t / length > hit.t)
                 return false;
 
-            Vector3f position = ray.at(t / length);
-            Vector3f normal;
-            normal[minIdx] = dir[minIdx] < 0 ? -1 : 1;
-
-            hit.set(t / length, nullptr, {position, normal});
+            hit.record(t / length, nullptr, nullptr); // Only t is read, no surface
             return true;
         }
     }
 
-    virtual std::pair<HitSurface, double> samplePoint(RandomEngine&reng) const override {
+    virtual std::pair<HitSurface, double> samplePoint(Sampler&reng) const override {
         return std::make_pair(HitSurface {
             Vector3f::ZERO,
             Vector3f::ZERO,
@@ -95,6 +80,10 @@ public:
 
     Vector3f getCenter() const { return (URF + LLB) / 2.; }
 
+    const Vector3f &getURF() const { return URF; }
+
+    const Vector3f &getLLB() const { return LLB; }
+
     BBox* getChild(int octant) const {
         Vector3f center = getCenter();
         assert(octant >= 0 && octant < 8);
@@ -28,7 +28,12 @@ public:
         return result;
     }
 
-    virtual std::pair<HitSurface, double> samplePoint(RandomEngine &reng) const override {
+    virtual void intersectPacket(const Ray *rays, Hit *hits, char *found, int n, double tmin) const override {
+        for (Object3D *item : this->objList)
+            item->intersectPacket(rays, hits, found, n, tmin);
+    }
+
+    virtual std::pair<HitSurface, double> samplePoint(Sampler &reng) const override {
         int size = objList.size();
         double pdf = 1. / size;
 
@@ -44,5 +44,10 @@ public:
 
     virtual bool intersect(const Ray &r, Hit &h, double tmin) const;
 
-    virtual std::pair<HitSurface, double> samplePoint(RandomEngine &reng) const;
+    // The primitive of the hit is the index of its face
+    virtual void computeSurface(const Ray &r, Hit &h) const;
+
+    virtual void intersectPacket(const Ray *rays, Hit *hits, char *found, int n, double tmin) const;
+
+    virtual std::pair<HitSurface, double> samplePoint(Sampler &reng) const;
 };
\ No newline at end of file
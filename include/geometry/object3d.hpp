@@ -12,14 +12,29 @@ protected:
 public:
     Object3D(): material(nullptr) { }
 
-    virtual ~Object3D() { delete material; }
+    virtual ~Object3D() = default; // Materials belong to the scene parser
 
     explicit Object3D(Material *_material)
         : material(_material) { }
 
-    // Intersect Ray with this object. If hit, store information in hit structure.
+    // Intersect Ray with this object. If hit, record it in hit structure, see Hit::computeSurface.
     virtual bool intersect(const Ray &r, Hit &h, double tmin) const = 0;
 
+    // Surface of a hit recorded by this object
+    virtual void computeSurface(const Ray &r, Hit &h) const { }
+
+    // Intersect n rays, found[i] is set when rays[i] hits this object closer than hits[i]
+    virtual void intersectPacket(const Ray *rays, Hit *hits, char *found, int n, double tmin) const {
+        for (int i = 0; i < n; i++)
+            found[i] |= this->intersect(rays[i], hits[i], tmin);
+    }
+
     // Sample point on the object
-    virtual std::pair<HitSurface, double> samplePoint(RandomEngine &reng) const = 0;
-};
\ No newline at end of file
+    virtual std::pair<HitSurface, double> samplePoint(Sampler &reng) const = 0;
+};
+
+inline void Hit::computeSurface(const Ray &r) {
+    if (!this->object) return;
+    this->object->computeSurface(r, *this);
+    this->object = nullptr;
+}
\ No newline at end of file
@@ -32,6 +32,12 @@ public:
         if (t < tmin || t > h.t)
             return false;
 
+        h.record(t, material, this);
+        return true;
+    }
+
+    virtual void computeSurface(const Ray &r, Hit &h) const override {
+        double t = h.t;
         if (textured && material->textured()) {
             Vector3f pos = r.at(t) - this->origin;
             double e =
@@ -43,14 +49,13 @@ public:
             double s2 =
                 Vector3f::dot(pos, text[1]) * text[0].squaredLength() -
                 Vector3f::dot(text[0], text[1]) * Vector3f::dot(pos, text[0]); 
-            h.set(t, material, HitSurface(r.at(t), n, n, Vector2f(s1 / e, s2 / e), true));
+            h.surface = HitSurface(r.at(t), n, n, Vector2f(s1 / e, s2 / e), true);
         } else {
-            h.set(t, material, HitSurface(r.at(t), n));
+            h.surface = HitSurface(r.at(t), n);
         }
-        return true;
     }
 
-    virtual std::pair<HitSurface, double> samplePoint(RandomEngine &reng) const override {
+    virtual std::pair<HitSurface, double> samplePoint(Sampler &reng) const override {
 		return std::make_pair(HitSurface { Vector3f::ZERO, n }, -1.);
 	}
 
@@ -96,28 +96,12 @@ public:
                 return false;
 
             Vector3f position = ray.at(tmax / length);
-            Vector3f normal;
-
-            for (int i = 0; i < 3; i++) {
-                if (maxIdx != i) {
-                    if (position[i] < LLB[i] || position[i] > URF[i])
-                        return false;
-                    else { }
-                } else {
-                    normal[i] = (pos[i] == RIGHT)? 1 : -1;
-                }
-            }
 
-            if (this->material->textured()) {
-                int face = maxIdx * 2 + (normal[maxIdx] > 0 ? 0 : 1);
-                hit.set(
-                    tmax / length,
-                    this->material,
-                    HitSurface(position, normal, normal, getUV(position, face), true) 
-                );
-            } else {
-                hit.set(tmax / length, this->material, {position, normal});
-            }
+            for (int i = 0; i < 3; i++)
+                if (maxIdx != i && (position[i] < LLB[i] || position[i] > URF[i]))
+                    return false;
+
+            hit.record(tmax / length, this->material, this, maxIdx * 2 + (pos[maxIdx] == RIGHT ? 0 : 1));
             return true;
         } else {
             double t = INFINITY;
@@ -132,25 +116,25 @@ public:
             if (t / length < tmin || t / length > hit.t)
                 return false;
 
-            Vector3f position = ray.at(t / length);
-            Vector3f normal;
-            normal[minIdx] = dir[minIdx] < 0 ? -1 : 1;
-
-            if (this->material->textured()) {
-                int face = minIdx * 2 + ((normal[minIdx] > 0)? 0 : 1);
-                hit.set(
-                    t / length,
-                    this->material,
-                    HitSurface(position, normal, normal, getUV(position, face), true)
-                );
-            } else {
-                hit.set(t / length, this->material, {position, normal});
-            }
+            hit.record(t / length, this->material, this, minIdx * 2 + (dir[minIdx] < 0 ? 1 : 0));
             return true;
         }
     }
 
-    std::pair<HitSurface, double> samplePoint(RandomEngine&reng) const override {
+    // The primitive of the hit is its face, 2 * axis + (0 - positive, 1 - negative)
+    void computeSurface(const Ray &ray, Hit &hit) const override {
+        int face = hit.primitive;
+        Vector3f position = ray.at(hit.t);
+        Vector3f normal;
+        normal[face / 2] = face % 2 ? -1 : 1;
+
+        if (this->material->textured())
+            hit.surface = HitSurface(position, normal, normal, getUV(position, face), true);
+        else
+            hit.surface = HitSurface(position, normal);
+    }
+
+    std::pair<HitSurface, double> samplePoint(Sampler&reng) const override {
         double areaXY, areaYZ, areaZX;
         areaXY = (URF[0] - LLB[0]) * (URF[1] - LLB[1]);
         areaYZ = (URF[1] - LLB[1]) * (URF[2] - LLB[2]);
@@ -179,7 +163,7 @@ public:
                 Vector3f(which ? -1 : 1, 0, 0)
             }, pdf);
         } else {
-            bool which = face - areaXY - areaZX < (areaZX / 2.);
+            bool which = face - areaXY - areaYZ < (areaZX / 2.);
             return std::make_pair(HitSurface {
                 Vector3f(
                     LLB[0] + reng.getUniformDouble(0, 1) * (URF[0] - LLB[0]),
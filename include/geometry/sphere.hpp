@@ -40,13 +40,17 @@ public:
 
         if (t < tmin || t >= h.t) return false;
 
-        h.set(t, material, HitSurface {
-            r.at(t), (r.at(t) - center).normalized()
-        });
+        h.record(t, material, this);
         return true;
     }
 
-    virtual std::pair<HitSurface, double> samplePoint(RandomEngine &reng) const override {
+    virtual void computeSurface(const Ray &r, Hit &h) const override {
+        h.surface = HitSurface {
+            r.at(h.t), (r.at(h.t) - center).normalized()
+        };
+    }
+
+    virtual std::pair<HitSurface, double> samplePoint(Sampler &reng) const override {
 		float phi = 2 * M_PI * reng.getUniformDouble(0, 1);
 		float z = 2 * reng.getUniformDouble(0, 1) - 1;
 		Vector3f normal(std::sqrt(1 - z * z) * std::cos(phi), std::sqrt(1 - z * z) * std::sin(phi), z);
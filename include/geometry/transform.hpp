@@ -2,6 +2,8 @@
 
 #include "geometry/object3d.hpp"
 
+#include <vector>
+
 class Transform : public Object3D {
 private:
     Object3D *obj;
@@ -17,23 +19,83 @@ public:
 
     virtual ~Transform() override = default;
 
+    /**
+     * @note: The object is intersected with the ray taken to its space & normalized there,
+     * so its t are the ones of the world scaled by the length of the taken direction.
+     * tmin stays an offset of the object space. Only the record of the object's hit is
+     * kept, computeSurface takes the ray to the object space again for the closest one.
+     */
     virtual bool intersect(const Ray &r, Hit &h, double tmin) const override {
+        double scale;
+        Ray tr = this->toObject(r, scale);
+
+        Hit inner;
+        inner.t = h.t * scale;
+        if (!obj->intersect(tr, inner, tmin)) return false;
+        this->record(r, tr, scale, inner, h);
+        return true;
+    }
+
+    virtual void intersectPacket(const Ray *rays, Hit *hits, char *found, int n, double tmin) const override {
+        std::vector<Ray> trRays;
+        std::vector<double> scales(n);
+        std::vector<Hit> inner(n);
+        trRays.reserve(n);
+        for (int i = 0; i < n; i++) {
+            trRays.push_back(this->toObject(rays[i], scales[i]));
+            inner[i].t = hits[i].t * scales[i];
+        }
+
+        std::vector<char> inter(n, 0);
+        obj->intersectPacket(trRays.data(), inner.data(), inter.data(), n, tmin);
+        for (int i = 0; i < n; i++) {
+            if (!inter[i]) continue;
+            this->record(rays[i], trRays[i], scales[i], inner[i], hits[i]);
+            found[i] = 1;
+        }
+    }
+
+    virtual void computeSurface(const Ray &r, Hit &h) const override {
+        double scale;
+        Ray tr = this->toObject(r, scale);
+
+        Hit inner;
+        inner.record(h.t * scale, h.material, h.inner, h.primitive, h.u, h.v);
+        this->toWorld(r, tr, scale, inner, h);
+    }
+
+    // Ray r taken to the object space, scale is the length of its direction there
+    Ray toObject(const Ray &r, double &scale) const {
         Vector3f trSource = (trans * Vector4f(r.o, 1)).xyz();
         Vector3f trDirection = (trans * Vector4f(r.d, 0)).xyz();
-        Ray tr(trSource, trDirection);
-        bool inter = obj->intersect(tr, h, tmin);
-        if (inter)
-            h.surface = HitSurface(
-                r.at(h.t),
-                (trans.transposed() * Vector4f(h.surface.normal, 0)).xyz().normalized(),
-                (trans.transposed() * Vector4f(h.surface.geoNormal, 0)).xyz().normalized(),
-                h.surface.cord,
-                h.surface.hasTexture
-            );
-        return inter;
-    }
-
-    std::pair<HitSurface, double> samplePoint(RandomEngine &reng) const override {
+        scale = trDirection.length();
+        return Ray(trSource, trDirection);
+    }
+
+    // Hit h of the world from the hit inner of the object, found with tr
+    void record(const Ray &r, const Ray &tr, double scale, Hit &inner, Hit &h) const {
+        // Surfaces computed already & Transforms inside, which keep a record of their own
+        if (!inner.object || inner.inner) {
+            this->toWorld(r, tr, scale, inner, h);
+            return;
+        }
+        h.record(inner.t / scale, inner.material, this, inner.primitive, inner.u, inner.v);
+        h.inner = inner.object;
+    }
+
+    void toWorld(const Ray &r, const Ray &tr, double scale, Hit &inner, Hit &h) const {
+        inner.computeSurface(tr);
+        double t = inner.t / scale;
+        h.set(t, inner.material, HitSurface(
+            r.at(t),
+            (trans.transposed() * Vector4f(inner.surface.normal, 0)).xyz().normalized(),
+            (trans.transposed() * Vector4f(inner.surface.geoNormal, 0)).xyz().normalized(),
+            inner.surface.cord,
+            inner.surface.hasTexture
+        ));
+    }
+
+    std::pair<HitSurface, double> samplePoint(Sampler &reng) const override {
         auto s = obj->samplePoint(reng);
         return std::make_pair(HitSurface {
             (trans.inverse() * Vector4f(s.first.position, 1)).xyz(),
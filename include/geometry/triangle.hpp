@@ -43,32 +43,53 @@ public:
         textured = true;
     }
 
-    bool intersect(const Ray &ray, Hit &hit, double tmin) const override {
+    // Meshes keep their faces as indices, they intersect them through these
+    static bool intersectFace(
+        const Ray &ray, double tmin, double tmax, const Vector3f vertices[3],
+        double &t, double &beta, double &gamma
+    ) {
         Vector3f e1 = vertices[0] - vertices[1];
         Vector3f e2 = vertices[0] - vertices[2];
         Vector3f s = vertices[0] - ray.o;
 
         double det1 = Matrix3f(ray.d, e1, e2).determinant();
-        if (abs(det1) < 1e-6) return false;
+        if (std::abs(det1) < 1e-6) return false;
 
-        double t = Matrix3f(s, e1, e2).determinant() / det1;
-        if (t < tmin || t >= hit.t) return false;
+        t = Matrix3f(s, e1, e2).determinant() / det1;
+        if (t < tmin || t >= tmax) return false;
 
-        double beta = Matrix3f(ray.d, s, e2).determinant() / det1;
+        beta = Matrix3f(ray.d, s, e2).determinant() / det1;
         if (beta < 0 || beta > 1) return false;
-        double gamma = Matrix3f(ray.d, e1, s).determinant() / det1;
+        gamma = Matrix3f(ray.d, e1, s).determinant() / det1;
         if (gamma < 0 || gamma > 1 || beta + gamma > 1) return false;
+        return true;
+    }
 
+    static HitSurface faceSurface(
+        const Vector3f &position, double beta, double gamma,
+        const Vector3f normal[3], const Vector3f &geoNormal,
+        const Vector2f cord[3], bool textured, Material *material
+    ) {
         Vector3f norm = (1 - beta - gamma) * normal[0] + beta * normal[1] + gamma * normal[2];
         Vector2f tex;
         if (textured && material->textured())
             tex = (1 - beta - gamma) * cord[0] + beta * cord[1] + gamma * cord[2];
-        
-        hit.set(t, material, HitSurface(ray.at(t), norm, geoNormal, tex, textured && material->textured()));
+
+        return HitSurface(position, norm, geoNormal, tex, textured && material->textured());
+    }
+
+    bool intersect(const Ray &ray, Hit &hit, double tmin) const override {
+        double t, beta, gamma;
+        if (!intersectFace(ray, tmin, hit.t, vertices, t, beta, gamma)) return false;
+        hit.record(t, material, this, 0, beta, gamma);
         return true;
     }
 
-    std::pair<HitSurface, double> samplePoint(RandomEngine &reng) const override {
+    void computeSurface(const Ray &ray, Hit &hit) const override {
+        hit.surface = faceSurface(ray.at(hit.t), hit.u, hit.v, normal, geoNormal, cord, textured, material);
+    }
+
+    std::pair<HitSurface, double> samplePoint(Sampler &reng) const override {
         double area = Vector3f::cross(vertices[1] - vertices[0], vertices[2] - vertices[0]).length() / 2.;
         double pdf = 1. / area;
         double a = reng.getUniformDouble(0, 1);
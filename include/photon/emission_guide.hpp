@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "utils/sampler.hpp"
+
+/**
+ * @ref: T. Hachisuka, H. W. Jensen. Robust Adaptive Photon Tracing Using Photon Path Visibility.
+ * Instead of the Markov chain used in the paper, we keep a histogram over the primary sample
+ * space (u, v) of the emitted direction of every light. Cells whose photons were gathered by
+ * the eye pass are considered visible and get more photons in the following iterations.
+ * A fraction of uniform emission is always kept so that every direction stays reachable.
+ */
+class EmissionGuide {
+private:
+    int lightNum;
+    int resolution;
+    double uniformRatio;
+
+    std::vector<double> importance; // Accumulated visibility of every cell
+    std::vector<double> cdf; // Per light, resolution^2 entries
+
+    int cellNum() const { return this->resolution * this->resolution; }
+
+    // Density of the cell relative to the uniform emission
+    double cellPdf(int source) const {
+        int cell = source % this->cellNum();
+        double prev = cell == 0 ? 0. : this->cdf[source - 1];
+        return (this->cdf[source] - prev) * this->cellNum();
+    }
+
+public:
+    EmissionGuide(int _lightNum, int _resolution, double _uniformRatio)
+        : lightNum(_lightNum), resolution(_resolution), uniformRatio(_uniformRatio) {
+        this->importance.assign(this->lightNum * this->cellNum(), 0.);
+        this->cdf.resize(this->lightNum * this->cellNum());
+        this->update();
+    }
+
+    /**
+     * @note: Warps (u, v) into the chosen cell and returns the cell id, which should be
+     * stored in the photon. pdf is the density relative to the uniform emission.
+     */
+    int sample(int lightId, double &u, double &v, double &pdf, Sampler &reng) const {
+        int n = this->cellNum();
+        auto begin = this->cdf.begin() + lightId * n;
+        double x = reng.getUniformDouble(0, 1);
+        int cell = std::min((int) (std::upper_bound(begin, begin + n, x) - begin), n - 1);
+
+        pdf = this->cellPdf(lightId * n + cell);
+        u = ((cell % this->resolution) + u) / this->resolution;
+        v = ((cell / this->resolution) + v) / this->resolution;
+        return lightId * n + cell;
+    }
+
+    /**
+     * @note: A gathered photon of the cell source. Hits are divided by the density the
+     * cell was emitted with, otherwise a favored cell would collect more hits only because
+     * it emits more photons. Must be called before the next update.
+     */
+    void record(int source, double weight) {
+        double w = weight / this->cellPdf(source);
+#pragma omp atomic
+        this->importance[source] += w;
+    }
+
+    // Rebuild the emission distribution from the visibility recorded so far
+    void update() {
+        int n = this->cellNum();
+        for (int l = 0; l < this->lightNum; l++) {
+            double total = 0.;
+            for (int i = 0; i < n; i++)
+                total += this->importance[l * n + i];
+
+            double acc = 0.;
+            for (int i = 0; i < n; i++) {
+                double p = total > 0.
+                    ? this->uniformRatio / n + (1. - this->uniformRatio) * this->importance[l * n + i] / total
+                    : 1. / n;
+                acc += p;
+                this->cdf[l * n + i] = acc;
+            }
+            this->cdf[l * n + n - 1] = 1.;
+        }
+    }
+};
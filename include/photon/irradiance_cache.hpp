@@ -0,0 +1,156 @@
+#pragma once
+
+#include <vecmath.h>
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+
+/**
+ * @ref: G. Ward et al. A Ray Tracing Solution for Diffuse Interreflection.
+ * Sparse irradiance records, each valid within its radius, stored in an octree.
+ * A record of radius R sits in the node of size s with 2R <= s < 4R containing it,
+ * so a lookup only visits the nodes whose box grown by s / 2 contains the point.
+ * Lookups take no lock & may run while other threads insert: nodes & records are
+ * fully written before being published through the atomic pointers.
+ */
+class IrradianceCache {
+private:
+    struct Record {
+        Vector3f position;
+        Vector3f normal;
+        Vector3f irradiance;
+        double radius;
+        Record *next;
+    };
+
+    struct Node {
+        Vector3f center;
+        double size; // Side of the cube
+        std::atomic<Node *> child[8];
+        std::atomic<Record *> records;
+
+        Node(const Vector3f &c, double s) : center(c), size(s), records(nullptr) {
+            for (int i = 0; i < 8; i++)
+                this->child[i] = nullptr;
+        }
+    };
+
+    std::atomic<Node *> root;
+    double accuracy; // Records weighted below 1 / accuracy are not used
+    double minRadius, maxRadius;
+
+    static int octant(const Node *node, const Vector3f &p) {
+        return (p[0] >= node->center[0]) + 2 * (p[1] >= node->center[1]) + 4 * (p[2] >= node->center[2]);
+    }
+
+    static bool inside(const Node *node, const Vector3f &p, double margin) {
+        double half = .5 * node->size + margin;
+        for (int k = 0; k < 3; k++)
+            if (std::abs(p[k] - node->center[k]) > half) return false;
+        return true;
+    }
+
+    static void release(Node *node) {
+        if (!node) return;
+        for (int i = 0; i < 8; i++)
+            release(node->child[i].load());
+        Record *record = node->records.load();
+        while (record) {
+            Record *next = record->next;
+            delete record;
+            record = next;
+        }
+        delete node;
+    }
+
+    void lookup(const Node *node, const Vector3f &p, const Vector3f &n, Vector3f &sum, double &weightSum) const {
+        if (!inside(node, p, .5 * node->size)) return;
+
+        for (const Record *record = node->records.load(); record; record = record->next) {
+            Vector3f d = p - record->position;
+            // Records in front of p are hidden from it
+            if (Vector3f::dot(d, record->normal + n) < -.02 * record->radius) continue;
+
+            double error =
+                d.length() / record->radius +
+                std::sqrt(std::max(0., 1. - (double) Vector3f::dot(n, record->normal)));
+            double weight = 1. / std::max(error, 1e-6);
+            if (weight <= 1. / this->accuracy) continue;
+
+            sum += weight * record->irradiance;
+            weightSum += weight;
+        }
+
+        for (int i = 0; i < 8; i++) {
+            const Node *child = node->child[i].load();
+            if (child) this->lookup(child, p, n, sum, weightSum);
+        }
+    }
+
+public:
+    IrradianceCache(double _accuracy, double _minRadius, double _maxRadius)
+        : root(nullptr), accuracy(_accuracy), minRadius(_minRadius), maxRadius(_maxRadius) { }
+
+    ~IrradianceCache() {
+        release(this->root.load());
+    }
+
+    // Radius of a record whose gather rays hit at the harmonic mean distance given
+    double clampRadius(double harmonicMean) const {
+        return std::min(std::max(harmonicMean, this->minRadius), this->maxRadius);
+    }
+
+    // Weighted irradiance of the records valid at p (normal n), false if none is
+    bool lookup(const Vector3f &p, const Vector3f &n, Vector3f &irradiance) const {
+        const Node *node = this->root.load();
+        if (!node) return false;
+
+        Vector3f sum = Vector3f::ZERO;
+        double weightSum = 0.;
+        this->lookup(node, p, n, sum, weightSum);
+        if (weightSum <= 0) return false;
+
+        irradiance = sum / weightSum;
+        return true;
+    }
+
+    // Thread safe
+    void insert(const Vector3f &p, const Vector3f &n, const Vector3f &irradiance, double radius) {
+        Record *record = new Record { p, n, irradiance, radius, nullptr };
+
+#pragma omp critical(irradiance_cache)
+        {
+            // The root grows towards p until it contains it, our scenes are unbounded
+            Node *node = this->root.load();
+            if (!node) {
+                node = new Node(p, 4. * radius);
+                this->root = node;
+            }
+            while (!inside(node, p, 0.) || node->size < 2. * radius) {
+                Vector3f center = node->center;
+                for (int k = 0; k < 3; k++)
+                    center[k] += (p[k] >= node->center[k] ? .5 : -.5) * node->size;
+                Node *parent = new Node(center, 2. * node->size);
+                parent->child[octant(parent, node->center)] = node;
+                this->root = parent;
+                node = parent;
+            }
+
+            while (.5 * node->size >= 2. * radius) {
+                int q = octant(node, p);
+                Node *child = node->child[q].load();
+                if (!child) {
+                    Vector3f center = node->center;
+                    for (int k = 0; k < 3; k++)
+                        center[k] += ((q >> k) & 1 ? .25 : -.25) * node->size;
+                    child = new Node(center, .5 * node->size);
+                    node->child[q] = child;
+                }
+                node = child;
+            }
+
+            record->next = node->records.load();
+            node->records = record;
+        }
+    }
+};
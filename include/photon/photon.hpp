@@ -6,4 +6,6 @@ struct Photon {
     Vector3f pos;
     Vector3f direction;
     Vector3f power;
+    int source; // Emission cell of the photon in the adaptive emission guide, -1 if none
+    bool caustic; // Only bounced on specular surfaces since the light
 };
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "photon/photon.hpp"
+
+/**
+ * @note: The photon pass only depends on the scene & the lights, so the photon sets
+ * of every iteration can be traced once and reused for renders from other cameras.
+ *
+ * File layout, all little endian:
+ *     PhotonCacheHeader
+ *     per iteration: uint64_t count, PhotonRecord[count]
+ * The header is rewritten after each appended iteration, so an interrupted
+ * render still leaves a valid (shorter) cache behind.
+ */
+struct PhotonCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t iterations;
+    uint64_t key; // Scene & photon tracing parameters fingerprint
+};
+
+struct PhotonRecord {
+    float pos[3];
+    float direction[3];
+    float power[3];
+    int32_t source;
+    int32_t caustic; // 0 or 1, final gathering takes the caustics from the photon map
+};
+
+class PhotonCache {
+private:
+    FILE *file;
+    uint64_t key;
+
+    // Read only mapping of the iterations present when the cache was opened
+    void *mapped;
+    size_t mappedSize;
+    std::vector<size_t> offsets; // Offset of each iteration block in the mapping
+
+    int iterations; // Iterations stored in the file, including the ones appended by us
+
+    static const uint32_t VERSION = 2; // 1 - no caustic flag
+
+    void writeHeader() {
+        PhotonCacheHeader header;
+        memcpy(header.magic, "NRTPHOT", 8);
+        header.version = VERSION;
+        header.iterations = this->iterations;
+        header.key = this->key;
+        fseek(this->file, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, this->file);
+        fseek(this->file, 0, SEEK_END);
+        fflush(this->file);
+    }
+
+    bool map(const char *filename) {
+        int fd = open(filename, O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(PhotonCacheHeader)) {
+            close(fd);
+            return false;
+        }
+
+        void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED) return false;
+
+        const PhotonCacheHeader *header = (const PhotonCacheHeader *) ptr;
+        if (memcmp(header->magic, "NRTPHOT", 8) != 0 || header->version != VERSION || header->key != this->key) {
+            printf("Photon cache %s does not match this scene, rebuilding it\n", filename);
+            munmap(ptr, st.st_size);
+            return false;
+        }
+
+        // Index the iteration blocks, dropping a truncated tail
+        size_t offset = sizeof(PhotonCacheHeader);
+        for (uint32_t i = 0; i < header->iterations; i++) {
+            if (offset + sizeof(uint64_t) > (size_t) st.st_size) break;
+            uint64_t count = *(const uint64_t *) ((const char *) ptr + offset);
+            if (offset + sizeof(uint64_t) + count * sizeof(PhotonRecord) > (size_t) st.st_size) break;
+            this->offsets.push_back(offset);
+            offset += sizeof(uint64_t) + count * sizeof(PhotonRecord);
+        }
+
+        this->mapped = ptr;
+        this->mappedSize = st.st_size;
+        this->iterations = this->offsets.size();
+        if (offset < (size_t) st.st_size)
+            truncate(filename, offset);
+        return true;
+    }
+
+public:
+    PhotonCache(const char *filename, uint64_t _key)
+        : file(nullptr), key(_key), mapped(nullptr), mappedSize(0), iterations(0) {
+        if (this->map(filename)) {
+            this->file = fopen(filename, "r+b");
+            printf("Loaded %d photon iterations from %s\n", this->iterations, filename);
+        } else {
+            this->file = fopen(filename, "w+b");
+        }
+
+        if (this->file == nullptr) {
+            printf("Cannot open photon cache %s\n", filename);
+            return;
+        }
+        this->writeHeader();
+    }
+
+    ~PhotonCache() {
+        if (this->mapped) munmap(this->mapped, this->mappedSize);
+        if (this->file) fclose(this->file);
+    }
+
+    bool load(int iteration, std::vector<Photon> &photonList) const {
+        if (iteration >= (int) this->offsets.size()) return false;
+
+        const char *base = (const char *) this->mapped + this->offsets[iteration];
+        uint64_t count = *(const uint64_t *) base;
+        const PhotonRecord *records = (const PhotonRecord *) (base + sizeof(uint64_t));
+
+        photonList.resize(count);
+        for (uint64_t i = 0; i < count; i++) {
+            const PhotonRecord &r = records[i];
+            photonList[i] = Photon {
+                Vector3f(r.pos[0], r.pos[1], r.pos[2]),
+                Vector3f(r.direction[0], r.direction[1], r.direction[2]),
+                Vector3f(r.power[0], r.power[1], r.power[2]),
+                r.source,
+                r.caustic != 0,
+            };
+        }
+        return true;
+    }
+
+    // Only appends right after the last stored iteration
+    void store(int iteration, const std::vector<Photon> &photonList) {
+        if (this->file == nullptr || iteration != this->iterations) return;
+
+        std::vector<PhotonRecord> records(photonList.size());
+        for (size_t i = 0; i < photonList.size(); i++) {
+            const Photon &p = photonList[i];
+            for (int k = 0; k < 3; k++) {
+                records[i].pos[k] = p.pos[k];
+                records[i].direction[k] = p.direction[k];
+                records[i].power[k] = p.power[k];
+            }
+            records[i].source = p.source;
+            records[i].caustic = p.caustic;
+        }
+
+        uint64_t count = records.size();
+        fseek(this->file, 0, SEEK_END);
+        fwrite(&count, sizeof(count), 1, this->file);
+        fwrite(records.data(), sizeof(PhotonRecord), records.size(), this->file);
+        this->iterations++;
+        this->writeHeader();
+    }
+};
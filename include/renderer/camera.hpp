@@ -3,10 +3,55 @@
 #include <vecmath.h>
 #include <cmath>
 #include <float.h>
+#include <vector>
 
-#include "utils/random_engine.hpp"
+#include "utils/sampler.hpp"
 #include "renderer/ray.hpp"
 
+/**
+ * @note: Camera rays of a batch, one array per component. The sampler values are drawn
+ * sample by sample, in the order sampleRay reads them, then Camera::generateRays turns
+ * the whole batch into rays in one loop. All the rays leave from the camera center.
+ */
+class CameraBatch {
+public:
+    bool lens; // Lens points are drawn after the pixel jitter
+    std::vector<int> x, y;
+    std::vector<double> jx, jy; // Pixel jitter in [-0.5, 0.5]^2
+    std::vector<double> lu, lv; // Lens point in [-1, 1]^2
+    std::vector<double> dx, dy, dz; // Normalized
+
+    CameraBatch(bool _lens) : lens(_lens) { }
+
+    int size() const {
+        return this->x.size();
+    }
+
+    void clear() {
+        this->x.clear(); this->y.clear();
+        this->jx.clear(); this->jy.clear();
+        this->lu.clear(); this->lv.clear();
+        this->dx.clear(); this->dy.clear(); this->dz.clear();
+    }
+
+    void push(int _x, int _y, Sampler &reng) {
+        this->x.push_back(_x);
+        this->y.push_back(_y);
+        this->jx.push_back(reng.getUniformDouble(-0.5, 0.5));
+        this->jy.push_back(reng.getUniformDouble(-0.5, 0.5));
+        if (!this->lens) return;
+        this->lu.push_back(reng.getUniformDouble(-1, 1));
+        this->lv.push_back(reng.getUniformDouble(-1, 1));
+    }
+
+    Ray getRay(int i, const Vector3f &center) const {
+        Vector3f d(this->dx[i], this->dy[i], this->dz[i]);
+        Ray ray(center, d);
+        ray.d = d; // Normalized already, kept bit exact
+        return ray;
+    }
+};
+
 class Camera {
 protected:
     // Positional parameters
@@ -20,6 +65,48 @@ protected:
     int height;
     double gamma;
 
+    // Image point hit by the direction d of a pinhole with focal lengths (fx, fy)
+    bool toImage(const Vector3f &d, double fx, double fy, double &x, double &y) const {
+        double c = Vector3f::dot(d, this->direction);
+        if (c <= 0) return false;
+
+        x = Vector3f::dot(d, this->horizontal) / c * fx + .5 * this->width;
+        y = Vector3f::dot(d, this->up) / c * fy + .5 * this->height;
+        return x >= -.5 && x < this->width - .5 && y >= -.5 && y < this->height - .5;
+    }
+
+    /**
+     * @note: Fills the directions of batch, calling Model::getDirection without a virtual
+     * dispatch so that it inlines into the loop. The sums follow the ones of sampleRay.
+     */
+    template <typename Model>
+    static void generateRays(const Model &model, CameraBatch &batch) {
+        int n = batch.size();
+        batch.dx.resize(n);
+        batch.dy.resize(n);
+        batch.dz.resize(n);
+        for (int i = 0; i < n; i++) {
+            double u = batch.lens ? batch.lu[i] : 0.;
+            double v = batch.lens ? batch.lv[i] : 0.;
+            model.Model::getDirection(batch.x[i], batch.y[i], batch.jx[i], batch.jy[i], u, v, batch.dx[i], batch.dy[i], batch.dz[i]);
+        }
+    }
+
+    // From the center, d is normalized already & kept bit exact
+    Ray makeRay(const Vector3f &d) const {
+        Ray ray(this->center, d);
+        ray.d = d;
+        return ray;
+    }
+
+    // Normalized as by Vector3f::normalized
+    static void normalize(double &x, double &y, double &z) {
+        double norm = sqrt(x * x + y * y + z * z);
+        x /= norm;
+        y /= norm;
+        z /= norm;
+    }
+
 public:
     Camera(
         const Vector3f &_center,
@@ -39,7 +126,33 @@ public:
     }
 
     virtual ~Camera() = default;
-    virtual Ray sampleRay(int x, int y, RandomEngine &) const = 0;
+    virtual Ray sampleRay(int x, int y, Sampler &) const = 0;
+
+    // Rays of a batch, the same ones as sampleRay gives for the sampler values drawn
+    virtual bool hasLens() const { return false; }
+    virtual void generateRays(CameraBatch &batch) const = 0;
+
+    /**
+     * @note: Inverse of sampleRay, i.e. the image point (x, y) whose rays pass through p.
+     * False when p is outside the view or the camera cannot be projected on.
+     */
+    virtual bool project(const Vector3f &p, double &x, double &y) const { return false; }
+
+    // Solid angle density of sampleRay picking dir, pixels having a unit area
+    virtual double getDirectionPdf(const Vector3f &dir) const { return 0.; }
+
+    /**
+     * @note: For light tracing, picks an image point (x, y) whose rays pass through p,
+     * returns the solid angle density of sampleRay generating the ray to p from that pixel,
+     * 0 if none does. All rays leave from the center.
+     */
+    virtual double sampleImportance(const Vector3f &p, double &x, double &y, Sampler &reng) const {
+        if (!this->project(p, x, y)) return 0.;
+        return this->getDirectionPdf(p - this->center);
+    }
+
+    Vector3f getCenter() const { return this->center; }
+    Vector3f getDirection() const { return this->direction; }
 
     int getWidth() { return this->width; }
     int getHeight() { return this->height; }
@@ -65,18 +178,40 @@ public:
         this->fx = this->fy;
     }
 
-    virtual Ray sampleRay(int x, int y, RandomEngine &reng) const override {
-        double delta_x = reng.getUniformDouble(-0.5, 0.5);
-        double delta_y = reng.getUniformDouble(-0.5, 0.5);
+    virtual Ray sampleRay(int x, int y, Sampler &reng) const override {
+        double jx = reng.getUniformDouble(-0.5, 0.5);
+        double jy = reng.getUniformDouble(-0.5, 0.5);
+        Vector3f d;
+        this->getDirection(x, y, jx, jy, 0., 0., d[0], d[1], d[2]);
+        return makeRay(d);
+    }
+
+    // Of pixel (x, y) jittered by (jx, jy), the lens point (u, v) is not used
+    void getDirection(int x, int y, double jx, double jy, double u, double v, double &dx, double &dy, double &dz) const {
+        double a = (x + jx - .5 * this->width) / this->fx;
+        double b = (.5 * this->height - y + jy) / this->fy;
+        double c = 1.;
+        normalize(a, b, c);
+
+        // rot * drc, rot = (horizontal, -up, direction)
+        dx = 0.; dx += this->horizontal[0] * a; dx += -this->up[0] * b; dx += this->direction[0] * c;
+        dy = 0.; dy += this->horizontal[1] * a; dy += -this->up[1] * b; dy += this->direction[1] * c;
+        dz = 0.; dz += this->horizontal[2] * a; dz += -this->up[2] * b; dz += this->direction[2] * c;
+        normalize(dx, dy, dz);
+    }
+
+    virtual void generateRays(CameraBatch &batch) const override {
+        Camera::generateRays(*this, batch);
+    }
 
-        Vector3f drc = Vector3f(
-            (x + delta_x - .5 * this->width) / this->fx,
-            (.5 * this->height - y + delta_y) / this->fy,
-            1.
-        ).normalized();
-        Matrix3f rot = Matrix3f(this->horizontal, -this->up, this->direction);
+    virtual bool project(const Vector3f &p, double &x, double &y) const override {
+        return this->toImage(p - this->center, this->fx, this->fy, x, y);
+    }
 
-        return Ray(this->center, rot * drc);
+    virtual double getDirectionPdf(const Vector3f &dir) const override {
+        double c = Vector3f::dot(dir.normalized(), this->direction);
+        if (c <= 0) return 0.;
+        return this->fx * this->fy / (c * c * c);
     }
 };
 
@@ -85,6 +220,27 @@ protected:
     double fx, fy;
     double aperture, f;
 
+    /**
+     * @ref: P. Shirley, K. Chiu. A Low Distortion Map Between Disk and Square.
+     * Unlike rejection, it keeps the stratification of (a, b) in [-1, 1]^2.
+     */
+    static void concentricDisk(double a, double b, double &u, double &v) {
+        if (a == 0 && b == 0) {
+            u = v = 0;
+            return;
+        }
+        double r, phi;
+        if (std::abs(a) > std::abs(b)) {
+            r = a;
+            phi = M_PI / 4 * (b / a);
+        } else {
+            r = b;
+            phi = M_PI / 2 - M_PI / 4 * (a / b);
+        }
+        u = r * cos(phi);
+        v = r * sin(phi);
+    }
+
 public:
     LenCamera(
         const Vector3f &_center,
@@ -104,27 +260,74 @@ public:
         this->f = _f;
     }
 
-    virtual Ray sampleRay(int x, int y, RandomEngine &reng) const override {
-        double delta_x = reng.getUniformDouble(-0.5, 0.5);
-        double delta_y = reng.getUniformDouble(-0.5, 0.5);
+    virtual Ray sampleRay(int x, int y, Sampler &reng) const override {
+        double jx = reng.getUniformDouble(-0.5, 0.5);
+        double jy = reng.getUniformDouble(-0.5, 0.5);
+        double u = reng.getUniformDouble(-1, 1);
+        double v = reng.getUniformDouble(-1, 1);
+        Vector3f d;
+        this->getDirection(x, y, jx, jy, u, v, d[0], d[1], d[2]);
+        return makeRay(d);
+    }
 
+    // Of pixel (x, y) jittered by (jx, jy), through the lens point (u, v) in [-1, 1]^2
+    void getDirection(int x, int y, double jx, double jy, double u, double v, double &dx, double &dy, double &dz) const {
         // Sample a point (u, v) inside circle x^2 + y^2 = (1/2 * aperture)^2
-        double u, v;
-        do {
-            u = reng.getUniformDouble(-1, 1);
-            v = reng.getUniformDouble(-1, 1);
-        } while (u * u + v * v > 1);
+        concentricDisk(u, v, u, v);
         u *= (.5 * this->aperture);
         v *= (.5 * this->aperture);
 
-        Vector3f r = u * this->up + v * this->horizontal;
-        Matrix3f rot = Matrix3f(this->horizontal, -this->up, this->direction);
-        Vector3f drc = Vector3f(
-            (x + delta_x - .5 * this->width) / this->fx,
-            (.5 * this->height - y + delta_y) / this->fy,
-            1.
-        ).normalized();
+        double a = (x + jx - .5 * this->width) / this->fx;
+        double b = (.5 * this->height - y + jy) / this->fy;
+        double c = 1.;
+        normalize(a, b, c);
+
+        // rot * drc - r, rot = (horizontal, -up, direction) & r = u * up + v * horizontal
+        dx = 0.; dx += this->horizontal[0] * a; dx += -this->up[0] * b; dx += this->direction[0] * c;
+        dy = 0.; dy += this->horizontal[1] * a; dy += -this->up[1] * b; dy += this->direction[1] * c;
+        dz = 0.; dz += this->horizontal[2] * a; dz += -this->up[2] * b; dz += this->direction[2] * c;
+        dx -= this->up[0] * u + this->horizontal[0] * v;
+        dy -= this->up[1] * u + this->horizontal[1] * v;
+        dz -= this->up[2] * u + this->horizontal[2] * v;
+        normalize(dx, dy, dz);
+        dx *= this->f;
+        dy *= this->f;
+        dz *= this->f;
+        normalize(dx, dy, dz);
+    }
+
+    virtual bool hasLens() const override { return true; }
+
+    virtual void generateRays(CameraBatch &batch) const override {
+        Camera::generateRays(*this, batch);
+    }
+
+    // The chief ray, through the middle of the lens
+    virtual bool project(const Vector3f &p, double &x, double &y) const override {
+        return this->toImage(p - this->center, this->fx, this->fy, x, y);
+    }
+
+    /**
+     * @note: A ray of sampleRay has the direction a - r, a the unit pixel direction & r the
+     * lens offset. Given the lens offset, a = r + s * w for the direction w to p, and the
+     * density is the pinhole one of a over the Jacobian (a . w) / s^2 of a -> w.
+     * Averaged over the lens, this is the importance of the lens camera.
+     */
+    virtual double sampleImportance(const Vector3f &p, double &x, double &y, Sampler &reng) const override {
+        double u, v;
+        concentricDisk(reng.getUniformDouble(-1, 1), reng.getUniformDouble(-1, 1), u, v);
+        Vector3f r = (.5 * this->aperture) * (u * this->up + v * this->horizontal);
+
+        Vector3f w = (p - this->center).normalized();
+        double b = Vector3f::dot(w, r);
+        double delta = b * b - r.squaredLength() + 1.;
+        if (delta <= 0) return 0.;
+        double s = -b + std::sqrt(delta);
+        if (s <= 0) return 0.;
 
-        return Ray(this->center, (rot * drc - r).normalized() * this->f);
+        Vector3f a = r + s * w;
+        if (!this->toImage(a, this->fx, this->fy, x, y)) return 0.;
+        double c = Vector3f::dot(a, this->direction);
+        return this->fx * this->fy / (c * c * c) * s * s / std::sqrt(delta);
     }
 };
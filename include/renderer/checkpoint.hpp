@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vecmath.h>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @note: Accumulation state of a progressive render, i.e. everything an iteration
+ * depends on besides the scene. The samplers are keyed by the iteration, so no
+ * generator state is needed to resume.
+ */
+struct RenderState {
+    int nextIter;
+    int iterDone;
+    double searchRadius;
+
+    std::vector<Vector3f> img; // Sum of the samples
+    std::vector<double> splat; // rgb per pixel
+    std::vector<int> budget;
+    std::vector<int> sampleCount;
+    std::vector<int> iterCount;
+    std::vector<double> lumSum;
+    std::vector<double> lumSqSum;
+};
+
+/**
+ * @note: File layout, all little endian:
+ *     CheckpointHeader
+ *     float img[3 * pixels], float splat[3 * pixels]
+ *     int32_t budget[pixels], sampleCount[pixels], iterCount[pixels]
+ *     float lumSum[pixels], lumSqSum[pixels]
+ * The file is written aside & renamed, so a crash while saving keeps the previous one.
+ */
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pixels;
+    uint64_t key; // Scene & render parameters fingerprint
+    int32_t nextIter;
+    int32_t iterDone;
+    double searchRadius;
+};
+
+class Checkpoint {
+private:
+    static const uint32_t VERSION = 1;
+
+    static void writeFloats(FILE *file, const double *values, size_t n) {
+        std::vector<float> buffer(values, values + n);
+        fwrite(buffer.data(), sizeof(float), n, file);
+    }
+
+    static bool readFloats(FILE *file, double *values, size_t n) {
+        std::vector<float> buffer(n);
+        if (fread(buffer.data(), sizeof(float), n, file) != n) return false;
+        for (size_t i = 0; i < n; i++)
+            values[i] = buffer[i];
+        return true;
+    }
+
+    static void writeInts(FILE *file, const std::vector<int> &values) {
+        std::vector<int32_t> buffer(values.begin(), values.end());
+        fwrite(buffer.data(), sizeof(int32_t), buffer.size(), file);
+    }
+
+    static bool readInts(FILE *file, std::vector<int> &values) {
+        std::vector<int32_t> buffer(values.size());
+        if (fread(buffer.data(), sizeof(int32_t), buffer.size(), file) != buffer.size()) return false;
+        values.assign(buffer.begin(), buffer.end());
+        return true;
+    }
+
+public:
+    static bool save(const std::string &filename, uint64_t key, const RenderState &state) {
+        std::string partial = filename + ".part";
+        FILE *file = fopen(partial.c_str(), "wb");
+        if (file == nullptr) {
+            printf("Cannot write checkpoint %s\n", filename.c_str());
+            return false;
+        }
+
+        size_t pixels = state.img.size();
+        CheckpointHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "NRTCKPT", 8);
+        header.version = VERSION;
+        header.pixels = pixels;
+        header.key = key;
+        header.nextIter = state.nextIter;
+        header.iterDone = state.iterDone;
+        header.searchRadius = state.searchRadius;
+        fwrite(&header, sizeof(header), 1, file);
+
+        std::vector<double> img(3 * pixels);
+        for (size_t i = 0; i < pixels; i++)
+            for (int k = 0; k < 3; k++)
+                img[3 * i + k] = state.img[i][k];
+        writeFloats(file, img.data(), img.size());
+        writeFloats(file, state.splat.data(), state.splat.size());
+        writeInts(file, state.budget);
+        writeInts(file, state.sampleCount);
+        writeInts(file, state.iterCount);
+        writeFloats(file, state.lumSum.data(), state.lumSum.size());
+        writeFloats(file, state.lumSqSum.data(), state.lumSqSum.size());
+
+        bool ok = !ferror(file);
+        ok = fclose(file) == 0 && ok;
+        if (!ok || std::rename(partial.c_str(), filename.c_str()) != 0) {
+            printf("Cannot write checkpoint %s\n", filename.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // state must already be sized for the image, it is left untouched on failure
+    static bool load(const std::string &filename, uint64_t key, RenderState &state) {
+        FILE *file = fopen(filename.c_str(), "rb");
+        if (file == nullptr) return false;
+
+        size_t pixels = state.img.size();
+        CheckpointHeader header;
+        if (fread(&header, sizeof(header), 1, file) != 1 ||
+            memcmp(header.magic, "NRTCKPT", 8) != 0 || header.version != VERSION ||
+            header.key != key || header.pixels != pixels) {
+            printf("Checkpoint %s does not match this render, starting over\n", filename.c_str());
+            fclose(file);
+            return false;
+        }
+
+        RenderState loaded = state;
+        loaded.nextIter = header.nextIter;
+        loaded.iterDone = header.iterDone;
+        loaded.searchRadius = header.searchRadius;
+
+        std::vector<double> img(3 * pixels);
+        bool ok =
+            readFloats(file, img.data(), img.size()) &&
+            readFloats(file, loaded.splat.data(), loaded.splat.size()) &&
+            readInts(file, loaded.budget) &&
+            readInts(file, loaded.sampleCount) &&
+            readInts(file, loaded.iterCount) &&
+            readFloats(file, loaded.lumSum.data(), loaded.lumSum.size()) &&
+            readFloats(file, loaded.lumSqSum.data(), loaded.lumSqSum.size());
+        fclose(file);
+        if (!ok) {
+            printf("Checkpoint %s is truncated, starting over\n", filename.c_str());
+            return false;
+        }
+
+        for (size_t i = 0; i < pixels; i++)
+            loaded.img[i] = Vector3f(img[3 * i], img[3 * i + 1], img[3 * i + 2]);
+        state = loaded;
+        return true;
+    }
+};
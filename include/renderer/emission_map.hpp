@@ -0,0 +1,168 @@
+#pragma once
+
+#include <vecmath.h>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+
+#include "renderer/ray.hpp"
+#include "utils/random_engine.hpp"
+
+#define EMISSION_MAP_RES 16
+#define EMISSION_MAP_PROBES 4 // Per texel, in each dimension
+#define EMISSION_MAP_FLOOR 0.05 // Weight kept for texels where no probe hit anything
+
+/**
+ * @note: A coarse cube map of emission directions around a point, weighted by
+ * whether probe rays through each texel hit the scene. Directions leaving
+ * the scene are not worth a photon, but every texel keeps a small weight, so that
+ * thin geometry missed by the probes is still reachable and the estimator stays unbiased.
+ */
+class EmissionMap {
+private:
+    std::vector<double> cdf;
+    std::vector<double> prob;
+
+    static int texelNum() { return 6 * EMISSION_MAP_RES * EMISSION_MAP_RES; }
+
+    // Face coordination (a, b) in [-1, 1]^2 to an unnormalized direction
+    static Vector3f toDirection(int face, double a, double b) {
+        int axis = face >> 1;
+        Vector3f d;
+        d[axis] = (face & 1) ? -1. : 1.;
+        d[(axis + 1) % 3] = a;
+        d[(axis + 2) % 3] = b;
+        return d;
+    }
+
+    static double texelCoord(int i, double offset) {
+        return -1. + (i + offset) * 2. / EMISSION_MAP_RES;
+    }
+
+    // Angle between the unit direction a & the great circle arc from p to q, whose plane normal is n
+    static double arcAngle(const Vector3f &a, const Vector3f &p, const Vector3f &q, const Vector3f &n) {
+        double s = Vector3f::dot(a, n);
+        Vector3f foot = a - s * n; // Closest point of the whole circle, unnormalized
+        if (foot.squaredLength() > 1e-24 &&
+            Vector3f::dot(Vector3f::cross(p, foot), n) >= 0 && Vector3f::dot(Vector3f::cross(foot, q), n) >= 0)
+            return std::asin(std::min(std::abs(s), 1.));
+        return std::acos(std::max(std::min(std::max(Vector3f::dot(a, p), Vector3f::dot(a, q)), 1.), -1.));
+    }
+
+    /**
+     * @note: Angle from the unit direction axis to the closest direction of a texel, 0 inside it.
+     * Texel edges are great circle arcs, so the texel is a convex spherical quadrilateral.
+     */
+    static double texelAngle(const Vector3f &axis, int face, int i, int j) {
+        Vector3f corner[4] = {
+            toDirection(face, texelCoord(i, 0), texelCoord(j, 0)).normalized(),
+            toDirection(face, texelCoord(i, 1), texelCoord(j, 0)).normalized(),
+            toDirection(face, texelCoord(i, 1), texelCoord(j, 1)).normalized(),
+            toDirection(face, texelCoord(i, 0), texelCoord(j, 1)).normalized(),
+        };
+        Vector3f normal[4];
+        int positive = 0, negative = 0;
+        for (int e = 0; e < 4; e++) {
+            normal[e] = Vector3f::cross(corner[e], corner[(e + 1) % 4]).normalized();
+            double s = Vector3f::dot(axis, normal[e]);
+            if (s >= 0) positive++;
+            if (s <= 0) negative++;
+        }
+        // On the inner side of every edge, & not the opposite texel
+        Vector3f center = toDirection(face, texelCoord(i, .5), texelCoord(j, .5));
+        if ((positive == 4 || negative == 4) && Vector3f::dot(axis, center) > 0) return 0.;
+
+        double angle = M_PI;
+        for (int e = 0; e < 4; e++)
+            angle = std::min(angle, arcAngle(axis, corner[e], corner[(e + 1) % 4], normal[e]));
+        return angle;
+    }
+
+public:
+    /**
+     * @param axis, angle: the cone that may carry light at all (e.g. of a spot light), angle >= pi - the whole sphere
+     * @param hitScene: whether a ray from the light hits any geometry
+     */
+    EmissionMap(
+        const Vector3f &pos,
+        const Vector3f &axis,
+        double angle,
+        const std::function<bool(const Ray &)> &hitScene
+    ) {
+        RandomEngine reng(0);
+        std::vector<double> weight(texelNum());
+        const double texelArea = 4. / (EMISSION_MAP_RES * EMISSION_MAP_RES);
+        Vector3f dir = axis.normalized();
+        double threshold = angle >= M_PI ? -2. : std::cos(angle);
+
+        for (int face = 0; face < 6; face++)
+            for (int j = 0; j < EMISSION_MAP_RES; j++)
+                for (int i = 0; i < EMISSION_MAP_RES; i++) {
+                    // Texels touching the cone stay reachable, however small the overlap
+                    if (angle < M_PI && texelAngle(dir, face, i, j) > angle) continue;
+
+                    int hit = 0;
+                    for (int k = 0; k < EMISSION_MAP_PROBES * EMISSION_MAP_PROBES; k++) {
+                        Vector3f d = toDirection(
+                            face,
+                            texelCoord(i, (k % EMISSION_MAP_PROBES + reng.getUniformDouble(0, 1)) / EMISSION_MAP_PROBES),
+                            texelCoord(j, (k / EMISSION_MAP_PROBES + reng.getUniformDouble(0, 1)) / EMISSION_MAP_PROBES)
+                        ).normalized();
+                        if (Vector3f::dot(d, dir) >= threshold && hitScene(Ray(pos, d))) hit++;
+                    }
+
+                    Vector3f center = toDirection(face, texelCoord(i, .5), texelCoord(j, .5));
+                    double solidAngle = texelArea / std::pow(center.length(), 3);
+                    double ratio = (double) hit / (EMISSION_MAP_PROBES * EMISSION_MAP_PROBES);
+                    weight[(face * EMISSION_MAP_RES + j) * EMISSION_MAP_RES + i] =
+                        solidAngle * std::max(ratio, EMISSION_MAP_FLOOR);
+                }
+
+        double total = 0.;
+        for (double w : weight) total += w;
+        this->prob.resize(texelNum());
+        this->cdf.resize(texelNum());
+        double acc = 0.;
+        for (int t = 0; t < texelNum(); t++) {
+            this->prob[t] = total > 0. ? weight[t] / total : 1. / texelNum();
+            acc += this->prob[t];
+            this->cdf[t] = acc;
+        }
+        this->cdf.back() = 1.;
+    }
+
+    /**
+     * @note: Maps the primary sample (u, v) to a direction, pdf is w.r.t. solid angle.
+     */
+    Vector3f sample(double u, double v, double &pdf) const {
+        int t = std::min((int) (std::upper_bound(this->cdf.begin(), this->cdf.end(), u) - this->cdf.begin()), texelNum() - 1);
+        while (this->prob[t] <= 0. && t > 0) t--; // Rounding at the end of the table
+        double prev = this->cdf[t] - this->prob[t];
+        u = std::min(std::max((u - prev) / this->prob[t], 0.), 1.);
+
+        int i = t % EMISSION_MAP_RES;
+        int j = (t / EMISSION_MAP_RES) % EMISSION_MAP_RES;
+        int face = t / (EMISSION_MAP_RES * EMISSION_MAP_RES);
+        Vector3f d = toDirection(face, texelCoord(i, u), texelCoord(j, v));
+
+        const double texelArea = 4. / (EMISSION_MAP_RES * EMISSION_MAP_RES);
+        pdf = this->prob[t] / texelArea * std::pow(d.length(), 3);
+        return d.normalized();
+    }
+
+    double getPdf(const Vector3f &dir) const {
+        int axis = 0;
+        for (int k = 1; k < 3; k++)
+            if (std::abs(dir[k]) > std::abs(dir[axis])) axis = k;
+        int face = axis * 2 + (dir[axis] < 0 ? 1 : 0);
+        Vector3f d = dir / std::abs(dir[axis]);
+
+        int i = std::min((int) ((d[(axis + 1) % 3] + 1.) * .5 * EMISSION_MAP_RES), EMISSION_MAP_RES - 1);
+        int j = std::min((int) ((d[(axis + 2) % 3] + 1.) * .5 * EMISSION_MAP_RES), EMISSION_MAP_RES - 1);
+        int t = (face * EMISSION_MAP_RES + j) * EMISSION_MAP_RES + i;
+
+        const double texelArea = 4. / (EMISSION_MAP_RES * EMISSION_MAP_RES);
+        return this->prob[t] / texelArea * std::pow(d.length(), 3);
+    }
+};
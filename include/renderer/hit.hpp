@@ -3,6 +3,9 @@
 #include <vecmath.h>
 
 #include "renderer/material.hpp"
+#include "renderer/ray.hpp"
+
+class Object3D;
 
 struct HitSurface {
     Vector3f position;
@@ -27,22 +30,35 @@ struct HitSurface {
     }
 };
 
+/**
+ * @note: While traversing, objects only record their closer hits: t, the object & where
+ * on it, e.g. the face & barycentrics. The surface is computed once for the closest one.
+ */
 class Hit {
 public:
     double t;
     Material *material;
     HitSurface surface;
 
+    const Object3D *object; // nullptr - the surface is computed already
+    const Object3D *inner; // Object hit under a Transform, see Transform::computeSurface
+    int primitive;
+    double u, v;
+
 public:
     Hit() {
         t = INFINITY;
         material = nullptr;
+        object = nullptr;
+        inner = nullptr;
     }
 
     Hit(double _t, Material *_material, const HitSurface &_surface) {
         t = _t;
         material = _material;
         surface = _surface;
+        object = nullptr;
+        inner = nullptr;
     }
 
     Hit(const Hit &h) = default;
@@ -51,7 +67,22 @@ public:
         t = _t;
         material = _material;
         surface = _surface;
+        object = nullptr;
+        inner = nullptr;
     }
 
+    void record(double _t, Material *_material, const Object3D *_object, int _primitive = 0, double _u = 0., double _v = 0.) {
+        t = _t;
+        material = _material;
+        object = _object;
+        inner = nullptr;
+        primitive = _primitive;
+        u = _u;
+        v = _v;
+    }
+
+    // Fills the surface of the recorded hit, r is the ray it was found with
+    void computeSurface(const Ray &r);
+
     ~Hit() = default;
 };
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "utils/scene_parser.hpp"
+#include "utils/image.hpp"
+#include "utils/pixel_sampler.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+/**
+ * @note: Renders a parsed scene into an image. Holds the options shared by
+ * all the integrators, i.e. camera sampling & path termination.
+ */
+class Integrator {
+protected:
+    PixelSamplerType pixelSampler;
+
+    int rouletteDepth; // Bounces before Russian roulette starts, negative - disabled
+    double rouletteMinSurvival;
+
+    /**
+     * @note: Survival probability of a path whose throughput is scaled by ratio,
+     * the survivors are divided by it to keep the estimator unbiased.
+     */
+    double survival(const Vector3f &ratio) const {
+        double q = std::max(ratio[0], std::max(ratio[1], ratio[2]));
+        if (std::isnan(q)) return 1.;
+        return std::min(1., std::max(this->rouletteMinSurvival, q));
+    }
+
+    static bool validVector(const Vector3f &v) {
+        return !(
+            v[0] < 0 || std::isinf(v[0]) || std::isnan(v[0]) ||
+            v[1] < 0 || std::isinf(v[1]) || std::isnan(v[1]) ||
+            v[2] < 0 || std::isinf(v[2]) || std::isnan(v[2])
+        );
+    }
+
+public:
+    Integrator()
+        : pixelSampler(PIXEL_SAMPLER_RANDOM), rouletteDepth(-1), rouletteMinSurvival(0.05) { }
+
+    virtual ~Integrator() = default;
+
+    virtual void render(SceneParser &parser, Image &image) = 0;
+
+    // Sampler of camera rays, it drives the subpixel offset, the lens & the first bounce
+    void setPixelSampler(PixelSamplerType type) {
+        this->pixelSampler = type;
+    }
+
+    /**
+     * @note: Terminate paths randomly after startDepth bounces, survival is
+     * proportional to the throughput but at least minSurvival. Off by default,
+     * paths then run to the maximum depth as they always did.
+     */
+    void setRussianRoulette(int startDepth, double minSurvival = 0.05) {
+        this->rouletteDepth = startDepth;
+        this->rouletteMinSurvival = std::min(1., std::max(1e-3, minSurvival));
+    }
+};
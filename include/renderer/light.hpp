@@ -4,13 +4,25 @@
 #include "utils/random_engine.hpp"
 #include "geometry/object3d.hpp"
 #include "utils/trans.hpp"
+#include "renderer/emission_map.hpp"
 
 #include <vecmath.h>
+#include <functional>
 
 struct RaySampleResult {
     Ray ray;
     Vector3f power;
     double pdf;
+    Vector3f normal; // At the emitting point, zero for point lights
+};
+
+struct LightSample {
+    Vector3f position;
+    Vector3f normal; // Zero for point lights
+    Vector3f dir; // From the shaded point towards the light, normalized
+    double dist;
+    Vector3f radiance; // Arriving at the shaded point
+    double pdf; // Solid angle density of dir, 1 for point lights
 };
 
 class Light {
@@ -20,20 +32,70 @@ public:
     virtual ~Light() = default;
 
     virtual Vector3f getIllumin(const Vector3f &dir) const = 0;
+
+    // Total emitted power (flux) of the light, used to distribute photons between lights
+    virtual Vector3f getPower() const = 0;
+
     virtual bool intersect(const Ray &r, Hit &h, double tmin) const = 0;
-    virtual RaySampleResult sampleRay(RandomEngine &reng) const = 0;
+
+    /**
+     * @note: Called once the scene is loaded, so that lights may stop wasting
+     * photons on directions that leave the scene without hitting anything.
+     */
+    virtual void restrictEmission(const std::function<bool(const Ray &)> &hitScene) { }
+
+    /**
+     * @note: (u, v) in [0, 1)^2 is the primary sample driving the emitted direction,
+     * so that callers may warp it (e.g. adaptive emission) before handing it over.
+     */
+    virtual RaySampleResult sampleRay(double u, double v, Sampler &reng) const = 0;
+
+    RaySampleResult sampleRay(Sampler &reng) const {
+        double u = reng.getUniformDouble(0, 1);
+        double v = reng.getUniformDouble(0, 1);
+        return this->sampleRay(u, v, reng);
+    }
+
+    // Sample the light as seen from p, for next event estimation
+    virtual LightSample sampleDirect(const Vector3f &p, Sampler &reng) const = 0;
+
+    /**
+     * @note: Solid angle density of sampleDirect from p hitting q with normal n. It only
+     * weights the strategies, so a uniform density over the area is enough.
+     */
+    virtual double getDirectPdf(const Vector3f &p, const Vector3f &q, const Vector3f &n) const { return 0.; }
+
+    // Cannot be hit by rays, only light sampling reaches it
+    virtual bool isDelta() const { return true; }
+
+    // Area density of picking an emitting point, with the same approximation as getDirectPdf
+    virtual double getAreaPdf() const { return 1.; }
+
+    // Density of sampleRay emitting from q (normal n) along dir, area density included
+    virtual double getEmissionPdf(const Vector3f &q, const Vector3f &n, const Vector3f &dir) const = 0;
 };
 
 class AreaLight : public Light {
 private:
     Object3D *obj;
     Vector3f power;
+    double area;
 
 public:
     AreaLight() = delete;
 
     AreaLight(Object3D *o, const Vector3f &p)
-        : obj(o), power(p) { }
+        : obj(o), power(p) {
+        // E[1 / pdf] over the emitter is its area, whatever the sampling strategy is
+        RandomEngine reng(0);
+        const int sampleNum = 4096;
+        this->area = 0.;
+        for (int i = 0; i < sampleNum; i++) {
+            double pdf = obj->samplePoint(reng).second;
+            if (pdf > 0) this->area += 1. / pdf;
+        }
+        this->area /= sampleNum;
+    }
 
     virtual ~AreaLight() override {
         delete obj;
@@ -43,11 +105,45 @@ public:
         return power;
     }
 
+    virtual Vector3f getPower() const override {
+        return M_PI * this->area * power;
+    }
+
     virtual bool intersect(const Ray &r, Hit &h, double tmin) const override {
         return obj->intersect(r, h, tmin);
     }
 
-    virtual RaySampleResult sampleRay(RandomEngine &reng) const override {
+    virtual bool isDelta() const override { return false; }
+
+    // One sided, light leaves along the normal as in sampleRay
+    virtual LightSample sampleDirect(const Vector3f &p, Sampler &reng) const override {
+        auto pair = obj->samplePoint(reng);
+        HitSurface surface = pair.first;
+
+        Vector3f d = surface.position - p;
+        double dist = d.length();
+        d = d / dist;
+        double cos_ = -Vector3f::dot(d, surface.normal);
+        if (cos_ <= 0 || pair.second <= 0)
+            return LightSample { surface.position, surface.normal, d, dist, Vector3f::ZERO, 0. };
+
+        return LightSample {
+            .position = surface.position,
+            .normal = surface.normal,
+            .dir = d,
+            .dist = dist,
+            .radiance = power,
+            .pdf = pair.second * dist * dist / cos_,
+        };
+    }
+
+    virtual double getDirectPdf(const Vector3f &p, const Vector3f &q, const Vector3f &n) const override {
+        Vector3f d = q - p;
+        double cos_ = std::abs(Vector3f::dot(d.normalized(), n));
+        return d.squaredLength() / (this->area * std::max(cos_, 1e-6));
+    }
+
+    virtual RaySampleResult sampleRay(double u, double v, Sampler &reng) const override {
         auto pair = obj->samplePoint(reng);
         HitSurface surface = pair.first;
         double pdf = pair.second;
@@ -56,8 +152,8 @@ public:
         Vector3f y = Trans::generateVertical(x);
         Vector3f z = Vector3f::cross(x, y).normalized();
 
-        double phi = 2 * M_PI * reng.getUniformDouble(0, 1);
-        double t = std::sqrt(reng.getUniformDouble(0, 1));
+        double phi = 2 * M_PI * u;
+        double t = std::sqrt(v);
         pdf *= t / M_PI;
 
         Vector3f out = Vector3f(std::sqrt(1 - t * t) * std::cos(phi), std::sqrt(1 - t * t) * std::sin(phi), t);
@@ -68,34 +164,79 @@ public:
             },
             .power = t * power,
             .pdf = pdf,
+            .normal = x,
         };
     }
+
+    virtual double getAreaPdf() const override {
+        return 1. / this->area;
+    }
+
+    virtual double getEmissionPdf(const Vector3f &q, const Vector3f &n, const Vector3f &dir) const override {
+        return this->getAreaPdf() * std::max(0., Vector3f::dot(n, dir.normalized())) / M_PI;
+    }
 };
 
 class PointLight : public Light {
 private:
     Vector3f pos;
     Vector3f power;
+    EmissionMap *emission; // nullptr - uniform over the sphere
 
 public:
     PointLight() = delete;
 
     PointLight(const Vector3f &_pos, const Vector3f &_power)
-        : pos(_pos), power(_power) { }
+        : pos(_pos), power(_power), emission(nullptr) { }
 
-    virtual ~PointLight() override = default;
+    virtual ~PointLight() override {
+        delete emission;
+    }
 
     virtual Vector3f getIllumin(const Vector3f &dir) const override {
         return power;
     }
 
+    virtual Vector3f getPower() const override {
+        return 4. * M_PI * power;
+    }
+
     virtual bool intersect(const Ray &r, Hit &h, double tmin) const override {
         return false;
     }
 
-    virtual RaySampleResult sampleRay(RandomEngine &reng) const override {
-        double phi = 2 * M_PI * reng.getUniformDouble(0, 1);
-        double z = reng.getUniformDouble(-1, 1);
+    virtual LightSample sampleDirect(const Vector3f &p, Sampler &reng) const override {
+        Vector3f d = pos - p;
+        double dist = d.length();
+        return LightSample {
+            .position = pos,
+            .normal = Vector3f::ZERO,
+            .dir = d / dist,
+            .dist = dist,
+            .radiance = power / (dist * dist),
+            .pdf = 1.,
+        };
+    }
+
+    virtual void restrictEmission(const std::function<bool(const Ray &)> &hitScene) override {
+        delete emission;
+        emission = new EmissionMap(pos, Vector3f(0, 0, 1), M_PI, hitScene);
+    }
+
+    virtual RaySampleResult sampleRay(double u, double v, Sampler &reng) const override {
+        if (emission) {
+            double pdf;
+            Vector3f out = emission->sample(u, v, pdf);
+            return RaySampleResult {
+                .ray = Ray { pos, out },
+                .power = power,
+                .pdf = pdf,
+                .normal = Vector3f::ZERO,
+            };
+        }
+
+        double phi = 2 * M_PI * u;
+        double z = 2 * v - 1;
         Vector3f out = Vector3f(
             std::sqrt(1 - z * z) * std::cos(phi),
             std::sqrt(1 - z * z) * std::sin(phi),
@@ -106,8 +247,13 @@ public:
             .ray = Ray { pos, out },
             .power = power,
             .pdf = 1. / (4. * M_PI),
+            .normal = Vector3f::ZERO,
         };
     }
+
+    virtual double getEmissionPdf(const Vector3f &q, const Vector3f &n, const Vector3f &dir) const override {
+        return emission ? emission->getPdf(dir.normalized()) : 1. / (4. * M_PI);
+    }
 };
 
 class DirectedPointLight : public Light {
@@ -116,6 +262,7 @@ private:
     Vector3f direction;
     Vector3f power;
     double angle;
+    EmissionMap *emission; // nullptr - uniform over the cone
 
 public:
     DirectedPointLight() = delete;
@@ -125,23 +272,60 @@ public:
         const Vector3f &_direction,
         const Vector3f &_power,
         double _angle
-    ) : pos(_pos), direction(_direction), power(_power), angle(_angle) { }
+    ) : pos(_pos), direction(_direction), power(_power), angle(_angle), emission(nullptr) { }
 
-    virtual ~DirectedPointLight() override = default;
+    virtual ~DirectedPointLight() override {
+        delete emission;
+    }
 
     virtual Vector3f getIllumin(const Vector3f &dir) const override {
         return power;
     }
 
+    virtual Vector3f getPower() const override {
+        return 2. * M_PI * (1. - std::cos(angle)) * power;
+    }
+
     virtual bool intersect(const Ray &r, Hit &h, double tmin) const override {
         return false;
     }
 
-    virtual RaySampleResult sampleRay(RandomEngine &reng) const override {
+    virtual LightSample sampleDirect(const Vector3f &p, Sampler &reng) const override {
+        Vector3f d = pos - p;
+        double dist = d.length();
+        bool inside = -Vector3f::dot(d / dist, direction.normalized()) >= std::cos(angle);
+        return LightSample {
+            .position = pos,
+            .normal = Vector3f::ZERO,
+            .dir = d / dist,
+            .dist = dist,
+            .radiance = inside ? power / (dist * dist) : Vector3f::ZERO,
+            .pdf = 1.,
+        };
+    }
+
+    virtual void restrictEmission(const std::function<bool(const Ray &)> &hitScene) override {
+        delete emission;
+        emission = new EmissionMap(pos, direction, angle, hitScene);
+    }
+
+    virtual RaySampleResult sampleRay(double u, double v, Sampler &reng) const override {
         double threshold = std::cos(angle);
 
-        double phi = 2 * M_PI * reng.getUniformDouble(0, 1);
-        double t = (1 - threshold) * reng.getUniformDouble(0, 1) + threshold;
+        if (emission) {
+            // The map is clipped to texels touching the cone, the rest of them carries no light
+            double pdf;
+            Vector3f out = emission->sample(u, v, pdf);
+            return RaySampleResult {
+                .ray = Ray { pos, out },
+                .power = power,
+                .pdf = Vector3f::dot(out, direction.normalized()) >= threshold ? pdf : -1.,
+                .normal = Vector3f::ZERO,
+            };
+        }
+
+        double phi = 2 * M_PI * u;
+        double t = (1 - threshold) * v + threshold;
         Vector3f out = Vector3f(
             std::sqrt(1 - t * t) * std::cos(phi),
             std::sqrt(1 - t * t) * std::sin(phi),
@@ -157,6 +341,14 @@ public:
             .ray = Ray { pos, out },
             .power = power,
             .pdf = 1. / (2 * M_PI * (1 - threshold)),
+            .normal = Vector3f::ZERO,
         };
     }
+
+    virtual double getEmissionPdf(const Vector3f &q, const Vector3f &n, const Vector3f &dir) const override {
+        Vector3f d = dir.normalized();
+        double threshold = std::cos(angle);
+        if (Vector3f::dot(d, direction.normalized()) < threshold) return 0.;
+        return emission ? emission->getPdf(d) : 1. / (2 * M_PI * (1 - threshold));
+    }
 };
\ No newline at end of file
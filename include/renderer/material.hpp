@@ -45,7 +45,16 @@ public:
      * @note: All use relative coordination.
      */
     virtual Vector3f shade(const Vector3f &in, const Vector3f &out, bool fromLight) const = 0;
-    virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, RandomEngine &reng) const = 0;
+    virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, Sampler &reng) const = 0;
+
+    /**
+     * @note: Density of getOutputRay picking out over its non specular lobes, used
+     * to weight light sampling against BSDF sampling.
+     */
+    virtual double getPdf(const Vector3f &in, const Vector3f &out) const { return 0.; }
+
+    // Only specular lobes, light sampling cannot contribute
+    virtual bool isSpecular() const { return false; }
 };
 
 class Specular : public Material {
@@ -65,7 +74,9 @@ public:
         return Vector3f::ZERO;
     }
 
-    virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, RandomEngine &reng) const override {
+    virtual bool isSpecular() const override { return true; }
+
+    virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, Sampler &reng) const override {
         Vector3f out = Trans::reflect(in, Vector3f(0, 0, 1));
         return IntersectResult {
             .x = this->color / (std::abs(out[2]) + 1e-6),
@@ -95,7 +106,9 @@ public:
         return Vector3f::ZERO;
     }
 
-    virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, RandomEngine &reng) const override {
+    virtual bool isSpecular() const override { return true; }
+
+    virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, Sampler &reng) const override {
         Vector3f reflectOut = Trans::reflect(in, Vector3f(0, 0, 1));
         Vector3f refractOut = in[2] >= 0 // Going into the medium
             ? Trans::refract(in, Vector3f(0, 0, 1), 1., n)
@@ -104,7 +117,7 @@ public:
             ? 1. / (n * n)
             : n * n;
         
-        double coi = abs(reflectOut[2]), cot = abs(refractOut[2]);
+        double coi = std::abs(reflectOut[2]), cot = std::abs(refractOut[2]);
         double rs = (coi - n * cot) * (coi - n * cot) / ((coi + n * cot) * (coi + n * cot));
         double rp = (cot - n * coi) * (cot - n * coi) / ((cot + n * coi) * (cot + n * coi));
 
@@ -156,7 +169,19 @@ public:
             + specularColor * pow(cos_, shininess) * (2 + shininess) / (2 * M_PI);
     }
 
-    virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, RandomEngine &reng) const override {
+    virtual double getPdf(const Vector3f &in, const Vector3f &out) const override {
+        Vector3f total = this->diffuseColor + this->specularColor;
+
+        double probR = std::min(1., std::max(total[0], std::max(total[1], total[2])));
+        double probD =
+            probR * (diffuseColor[0] + diffuseColor[1] + diffuseColor[2]) / (total[0] + total[1] + total[2]);
+
+        double cos_ = std::max(0., Vector3f::dot(out, Trans::reflect(in, Vector3f(0, 0, 1))));
+        return probD * std::max(0., (double) out[2]) / M_PI
+            + (probR - probD) * (shininess + 2.) * std::pow(cos_, shininess) / (2. * M_PI);
+    }
+
+    virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, Sampler &reng) const override {
         Vector3f total = this->diffuseColor + this->specularColor;
 
         double probR = std::max(total[0], std::max(total[1], total[2]));
@@ -228,7 +253,11 @@ public:
         return this->color / M_PI;
     }
 
-    virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, RandomEngine &reng) const override {
+    virtual double getPdf(const Vector3f &in, const Vector3f &out) const override {
+        return std::max(0., (double) out[2]) / M_PI;
+    }
+
+    virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, Sampler &reng) const override {
         double phi = 2 * M_PI * reng.getUniformDouble(0, 1);
         double t = std::sqrt(reng.getUniformDouble(0, 1));
 
@@ -291,7 +320,15 @@ public:
 		return Kd / M_PI + Ks * pow(cos_, Ns) * (2 + Ns) / (2 * M_PI) ;
 	}
 
-	virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, RandomEngine &reng) const override {
+	// Only the diffuse lobe, reflection & refraction are sampled as mirrors
+	virtual double getPdf(const Vector3f &in, const Vector3f &out) const override {
+		Vector3f total = Kd + Ks;
+		double probR = std::min(1., std::max(total[0], std::max(total[1], total[2])));
+		double probD = probR * (Kd[0] + Kd[1] + Kd[2]) / (total[0] + total[1] + total[2]);
+		return d * probD * std::max(0., (double) out[2]) / M_PI;
+	}
+
+	virtual IntersectResult getOutputRay(const Vector3f &in, bool fromLight, Sampler &reng) const override {
 		if (reng.getUniformDouble(0, 1) < d) { // Reflect
 			Vector3f total = Kd + Ks;
 
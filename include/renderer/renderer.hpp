@@ -1,20 +1,130 @@
 #pragma once
 
 #include "photon/photon_map.hpp"
+#include "photon/emission_guide.hpp"
+#include "photon/photon_cache.hpp"
+#include "photon/irradiance_cache.hpp"
 #include "utils/scene_parser.hpp"
 #include "utils/image.hpp"
 #include "utils/random_engine.hpp"
+#include "utils/pixel_sampler.hpp"
+#include "utils/counter_rng.hpp"
+#include "utils/tile_scheduler.hpp"
+#include "utils/snapshot_writer.hpp"
 #include "renderer/ray.hpp"
 #include "renderer/hit.hpp"
+#include "renderer/integrator.hpp"
+#include "renderer/checkpoint.hpp"
+#include "renderer/wavefront.hpp"
 
 #include <vector>
+#include <string>
 #include <omp.h>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <csignal>
+#include <chrono>
+#include <climits>
+#include <atomic>
+#include <future>
+#include <memory>
 
-class SPPMRenderer {
+// Sampler dimensions consumed along a photon path
+#define PHOTON_DIM_LIGHT 0
+#define PHOTON_DIM_GUIDE 1
+#define PHOTON_DIM_DIRECTION 2
+#define PHOTON_DIM_EMITTER 4
+#define PHOTON_DIM_BOUNCE 8
+#define PHOTON_DIM_PER_BOUNCE 6
+#define PHOTON_DIM_ROULETTE 5 // Offset inside a bounce, after the material ones
+
+// Seed of the counter based generator of photon paths, eye paths use 0
+#define RNG_STREAM_PHOTON 1
+#define RNG_STREAM_SPLAT 3 // Lens samples of the caustic splats
+#define RNG_STREAM_GATHER 4 // Final gather rays, per record
+
+// Sampler dimensions consumed along an eye path, after the camera ones
+#define EYE_DIM_BOUNCE 4
+#define EYE_DIM_PER_BOUNCE 6
+#define EYE_DIM_ROULETTE 5
+#define EYE_DIM_LIGHT 6 // Past the bounce ones, the final gather vertex ends the path
+
+// Irradiance records are valid within [1, 16] times the search radius
+#define GATHER_MAX_RADIUS 16.
+
+// Samples of a pixel in an iteration are at most this times rayNum with adaptive sampling
+#define ADAPTIVE_MAX_FACTOR 4
+#define ADAPTIVE_MIN_LUMINANCE 1e-2 // Floor of the mean in the relative error, for dark pixels
+
+/**
+ * @note: Final gathering looks up photons in a disc of this thickness, relative to the radius.
+ * A sphere takes in the photons of close parallel surfaces, e.g. a ceiling above a light,
+ * which many gather rays then find.
+ */
+#define GATHER_DISC_THICKNESS 0.1
+
+// Batched photon tracing
+#define PHOTON_BATCH 4096 // Photons in flight per thread
+#define PHOTON_BIN_CELLS 4 // Per axis, rays are binned by origin cell then direction octant
+
+// Time budget
+#define TIME_CALIBRATION_ITER 2 // Iterations timed before the photons are scaled
+#define TIME_MIN_ITER 16 // Iterations the photons are scaled down to fit in the budget
+#define TIME_MAX_PHOTON_SCALE 16 // Photons are divided by at most this
+
+enum SamplerType {
+    SAMPLER_RANDOM,
+    SAMPLER_HALTON,
+    SAMPLER_SOBOL,
+};
+
+// Photons of an iteration, traced ahead of its eye pass
+struct PhotonPass {
+    int iteration;
+    int photonNum; // Emitted, the time budget may change it between iterations
+    PhotonMap map;
+    std::vector<double> splat; // Light traced caustics, rgb per pixel
+    double seconds;
+    std::atomic<bool> cancel;
+};
+
+class SPPMRenderer : public Integrator {
 private:
-    PhotonMap gMap;
+    PhotonPass *photons; // Gathered by the current eye pass
+
+    EmissionGuide *guide;
+    int guideResolution; // 0 - uniform emission
+    double guideUniformRatio;
+
+    PhotonCache *cache;
+    std::string cacheFile; // Empty - no photon cache
+
+    bool causticSplat;
+
+    int gatherNum; // 0 - the photon map is looked up at the first diffuse hit
+    double gatherAccuracy;
+    IrradianceCache *irradianceCache;
+    int iteration; // Current one, keys the gather rays
+
+    double adaptiveThreshold; // 0 - every pixel gets rayNum samples per iteration
+    int adaptiveMinIter;
+
+    std::string snapshotPattern;
+    int snapshotInterval; // 0 - no snapshot
+    double snapshotSeconds;
+
+    std::string checkpointFile; // Empty - no checkpoint
+    int checkpointInterval;
+    bool resume;
+
+    bool wavefront; // Eye pass by stages over ray queues, instead of path by path
+
+    double timeBudget; // Seconds, 0 - run iter iterations
+    bool scalePhotons;
+    std::chrono::steady_clock::time_point renderStart;
+
+    SamplerType photonSampler;
 
     int photonNum;
     int rayNum;
@@ -25,92 +135,311 @@ private:
     double searchRadius;
     double alpha;
 
-    void buildPhotonMap(SceneParser &parser, std::vector<RandomEngine> &rengList) {
-        std::vector<Photon> photonList;
-        int lightNum = parser.getNumLights();
+    // Samplers of a photon, all indexed by its id & randomized per iteration
+    struct PhotonSamplers {
+        HaltonSampler halton;
+        SobolSampler sobol;
+        CounterSampler random;
 
-#pragma omp parallel for schedule(dynamic, 100)
-        // Traverse all the photons
-        for (int id = 0; id < this->photonNum; ++id) {
-            // Randomly get a light source
-            RandomEngine &reng = rengList[omp_get_thread_num()];
-            int lightId = reng.getUniformInt(0, lightNum - 1);
-            Light *light = parser.getLight(lightId);
-
-            // Sample a ray from this light source
-            auto result = light->sampleRay(reng);
-            Ray ray = result.ray;
-            Vector3f power = result.power;
+        PhotonSamplers(uint32_t iterSeed)
+            : halton(iterSeed), sobol(iterSeed), random(RNG_STREAM_PHOTON) { }
+
+        Sampler &start(SamplerType type, int iter_, int id) {
+            this->halton.startSample(id);
+            this->sobol.startSample(id);
+            this->random.startStream(iter_, id, 0, 0);
+            return
+                type == SAMPLER_HALTON ? (Sampler &) this->halton :
+                type == SAMPLER_SOBOL ? (Sampler &) this->sobol :
+                (Sampler &) this->random;
+        }
+    };
+
+    // Photon leaving a light, its power is over all the densities it was sampled with
+    RaySampleResult emitPhoton(SceneParser &parser, Sampler &reng, int &source) {
+        // Get a light source, proportionally to its power
+        reng.setDimension(PHOTON_DIM_LIGHT);
+        double lightPdf;
+        int lightId = parser.sampleLight(reng, lightPdf);
+        Light *light = parser.getLight(lightId);
+
+        // Sample a ray from this light source, guided by the visibility if needed
+        reng.setDimension(PHOTON_DIM_DIRECTION);
+        double u = reng.getUniformDouble(0, 1);
+        double v = reng.getUniformDouble(0, 1);
+        double guidePdf = 1.;
+        reng.setDimension(PHOTON_DIM_GUIDE);
+        source = this->guide ? this->guide->sample(lightId, u, v, guidePdf, reng) : -1;
+
+        reng.setDimension(PHOTON_DIM_EMITTER);
+        auto result = light->sampleRay(u, v, reng);
+        if (result.pdf >= 0)
+            result.power = result.power / std::max(1e-6, result.pdf * guidePdf * lightPdf);
+        return result;
+    }
+
+    /**
+     * @note: Photon id at its hit of the bounce dep, deposited into photons on diffuse
+     * surfaces. ray & power are moved on to the next bounce, false once the photon ends.
+     */
+    bool bouncePhoton(
+        SceneParser &parser, Sampler &reng, const Hit &hit, Ray &ray, Vector3f &power,
+        int id, int dep, int source, int &bounces, int &specularBounces,
+        PhotonPass &out, std::vector<std::pair<int, Photon>> &photons
+    ) {
+        // Calc the new power of photon & direction of it
+        Material *material = hit.material;
+        const HitSurface &surface = hit.surface;
+
+        /**
+         * @ref: https://github.com/Numendacil/Graphics/blob/master/include/render.hpp
+         */
+
+        // The input ray
+        Vector3f in = -ray.d.normalized();
+        Vector3f x = surface.normal;
+        Vector3f y = Trans::generateVertical(x);
+        Vector3f z = Vector3f::cross(x, y).normalized();
+        reng.setDimension(PHOTON_DIM_BOUNCE + dep * PHOTON_DIM_PER_BOUNCE);
+        auto res = material->getOutputRay(Trans::worldToLocal(y, z, x, in), true, reng);
+        Vector3f co = res.x;
+
+        if (res.isDiffuse) {
+            bool caustic = bounces > 0 && specularBounces == bounces;
+            photons.push_back(std::make_pair(id, Photon { surface.position, in, power, source, caustic }));
+            if (caustic && this->causticSplat) {
+                CounterSampler lens(RNG_STREAM_SPLAT);
+                lens.startStream(out.iteration, id, dep, 0);
+                this->splatToCamera(hit, in, power, parser, lens, out);
+            }
+        }
+        if (res.out == Vector3f::ZERO) return false; // Absorbed, no direction to go on with
+        bounces++;
+        if (!res.isDiffuse) specularBounces++;
+        if (surface.hasTexture && material->textured())
+            co = co * material->getTexturePixel(surface.cord);
 
+        Vector3f dir = Trans::localToWorld(y, z, x, res.out);
+        ray = Ray(surface.position, dir);
+        Vector3f scale =
+            co / std::max(res.pdf, 1e-6) *
+            std::abs(Vector3f::dot(dir, surface.geoNormal)) *
+            std::abs(Vector3f::dot(in, x)) /
+            std::abs(Vector3f::dot(in, surface.geoNormal));
+        power = power * scale;
+
+        // Russian roulette on the change of power through this bounce
+        if (this->rouletteDepth >= 0 && dep >= this->rouletteDepth) {
+            double q = this->survival(scale);
+            reng.setDimension(PHOTON_DIM_BOUNCE + dep * PHOTON_DIM_PER_BOUNCE + PHOTON_DIM_ROULETTE);
+            if (reng.getUniformDouble(0, 1) >= q) return false;
+            power = power / q;
+        }
+        return true;
+    }
+
+    /**
+     * @note: Photons [begin, end) traced together, bounce by bounce. The rays of a bounce
+     * are binned by origin cell & direction octant, so that the rays of a bin follow each
+     * other through the same nodes & triangles. The deposits are the ones of tracing the
+     * photons one by one, in the order of their bounces.
+     */
+    void tracePhotonBatch(SceneParser &parser, PhotonPass &out, int begin, int end, std::vector<std::pair<int, Photon>> &photons) {
+        PhotonSamplers samplers(SamplerUtils::hash(out.iteration));
+        RayQueue queue, next;
+        std::vector<int> bounces(end - begin, 0), specularBounces(end - begin, 0), source(end - begin, -1);
+        for (int id = begin; id < end; id++) {
+            Sampler &reng = samplers.start(this->photonSampler, out.iteration, id);
+            auto result = this->emitPhoton(parser, reng, source[id - begin]);
             if (result.pdf < 0) continue; // Invalid ray, pass it
-            power = power / std::max(1e-6, result.pdf) * lightNum;
+            queue.push(result.ray, result.power, id - begin);
+        }
 
-            auto validVector = [&](const Vector3f &v) -> bool {
-                return !(
-                    v[0] < 0 || std::isinf(v[0]) || std::isnan(v[0]) ||
-                    v[1] < 0 || std::isinf(v[1]) || std::isnan(v[1]) ||
-                    v[2] < 0 || std::isinf(v[2]) || std::isnan(v[2])
-                );
-            };
+        for (int dep = 0; dep < this->depth && queue.size() > 0; dep++) {
+            if (out.cancel || this->stopping()) return; // This iteration is dropped
 
-            // Let the photon travel & bump on objects, calc its power
-            for (int dep = 0; dep < this->depth; ++dep) {
-                if (!validVector(power)) break; // Invalid photon, pass it
+            // Bin, the cells split the bounds of the origins
+            int n = queue.size();
+            Vector3f lo(INFINITY, INFINITY, INFINITY), hi(-INFINITY, -INFINITY, -INFINITY);
+            for (int r = 0; r < n; r++) {
+                Vector3f o(queue.ox[r], queue.oy[r], queue.oz[r]);
+                for (int k = 0; k < 3; k++) {
+                    lo[k] = std::min(lo[k], o[k]);
+                    hi[k] = std::max(hi[k], o[k]);
+                }
+            }
+            queue.permute(Wavefront::sortBy(n, PHOTON_BIN_CELLS * PHOTON_BIN_CELLS * PHOTON_BIN_CELLS * 8, [&](int r) {
+                double o[3] = { queue.ox[r], queue.oy[r], queue.oz[r] };
+                int cell = 0;
+                for (int k = 0; k < 3; k++) {
+                    double extent = std::max((double) (hi[k] - lo[k]), 1e-12);
+                    int c = std::min(PHOTON_BIN_CELLS - 1, (int) ((o[k] - lo[k]) / extent * PHOTON_BIN_CELLS));
+                    cell = cell * PHOTON_BIN_CELLS + c;
+                }
+                return cell * 8 + queue.getOctant(r);
+            }));
 
-                // Get the next intersection
-                Hit hit;
+            // Extend
+            std::vector<Hit> hits(n);
+            std::vector<char> found(n, 0);
+            for (int r = 0; r < n; r++) {
+                if (!validVector(queue.getPower(r))) continue; // Invalid photon, pass it
                 bool isLight;
                 int lightId;
-                bool isIntersect = parser.intersect(ray, hit, 1e-6, isLight, lightId);
-                if (!isIntersect) break; // No intersect, photon travels straightly
+                found[r] = parser.intersect(queue.getRay(r), hits[r], 1e-6, isLight, lightId);
+            }
 
-                // Calc the new power of photon & direction of it
-                Material *material = hit.material;
-                HitSurface surface = hit.surface;
+            // Bounce, photons that miss travel straightly
+            next.clear();
+            for (int r = 0; r < n; r++) {
+                if (!found[r]) continue;
+                int slot = queue.slot[r], id = begin + slot;
+                Ray ray = queue.getRay(r);
+                Vector3f power = queue.getPower(r);
+                Sampler &reng = samplers.start(this->photonSampler, out.iteration, id);
+                if (this->bouncePhoton(parser, reng, hits[r], ray, power, id, dep, source[slot], bounces[slot], specularBounces[slot], out, photons))
+                    next.push(ray, power, slot);
+            }
+            std::swap(queue, next);
+        }
+    }
 
-                /**
-                 * @ref: https://github.com/Numendacil/Graphics/blob/master/include/render.hpp
-                 */
+    // May run alongside the eye pass of the previous iteration
+    void buildPhotonMap(SceneParser &parser, PhotonPass &out) {
+        int iter_ = out.iteration;
+        std::vector<Photon> photonList;
+        if (this->cache && this->cache->load(iter_, photonList)) {
+            out.map.set(photonList);
+            out.map.constructTree();
+            return;
+        }
 
-                // The input ray
-                Vector3f in = -ray.d.normalized();
-                Vector3f x = surface.normal;
-                Vector3f y = Trans::generateVertical(x);
-                Vector3f z = Vector3f::cross(x, y).normalized();
-                auto res = material->getOutputRay(Trans::worldToLocal(y, z, x, in), true, reng);
-                Vector3f co = res.x;
+        uint32_t iterSeed = SamplerUtils::hash(iter_);
 
-                if (res.isDiffuse) {
-#pragma omp critical
-                    {
-                        photonList.push_back(Photon { surface.position, in, power });
-                    }
-                }
-                if (surface.hasTexture && material->textured())
-                    co = co * material->getTexturePixel(surface.cord);
+        // Photons are tagged with their id, so that the map does not depend on the schedule
+        std::vector<std::vector<std::pair<int, Photon>>> threadPhotons(omp_get_max_threads());
 
-                Vector3f out = Trans::localToWorld(y, z, x, res.out);
-                ray = Ray(surface.position, out);
-                power =
-                    power * co / std::max(res.pdf, 1e-6) *
-                    std::abs(Vector3f::dot(out, surface.geoNormal)) *
-                    std::abs(Vector3f::dot(in, x)) /
-                    std::abs(Vector3f::dot(in, surface.geoNormal));
+        if (this->wavefront) {
+            int batchNum = (out.photonNum + PHOTON_BATCH - 1) / PHOTON_BATCH;
+#pragma omp parallel for schedule(dynamic, 1)
+            for (int b = 0; b < batchNum; b++) {
+                if (out.cancel || this->stopping()) continue; // This iteration is dropped
+                int end = std::min(out.photonNum, (b + 1) * PHOTON_BATCH);
+                this->tracePhotonBatch(parser, out, b * PHOTON_BATCH, end, threadPhotons[omp_get_thread_num()]);
+            }
+        } else {
+#pragma omp parallel for schedule(dynamic, 100)
+            // Traverse all the photons
+            for (int id = 0; id < out.photonNum; ++id) {
+                if (out.cancel || this->stopping()) continue; // This iteration is dropped
+                PhotonSamplers samplers(iterSeed);
+                Sampler &reng = samplers.start(this->photonSampler, iter_, id);
+
+                int source;
+                auto result = this->emitPhoton(parser, reng, source);
+                if (result.pdf < 0) continue; // Invalid ray, pass it
+                Ray ray = result.ray;
+                Vector3f power = result.power;
+                int bounces = 0, specularBounces = 0;
+
+                // Let the photon travel & bump on objects, calc its power
+                for (int dep = 0; dep < this->depth; ++dep) {
+                    if (!validVector(power)) break; // Invalid photon, pass it
+
+                    // Get the next intersection
+                    Hit hit;
+                    bool isLight;
+                    int lightId;
+                    bool isIntersect = parser.intersect(ray, hit, 1e-6, isLight, lightId);
+                    if (!isIntersect) break; // No intersect, photon travels straightly
+
+                    if (!this->bouncePhoton(parser, reng, hit, ray, power, id, dep, source, bounces, specularBounces, out, threadPhotons[omp_get_thread_num()]))
+                        break;
+                }
             }
         }
-        gMap.set(photonList);
-        gMap.constructTree();
+
+        if (out.cancel || this->stopping()) return; // Partial, not worth a tree nor the cache
+
+        std::vector<std::pair<int, Photon>> tagged;
+        for (auto &list : threadPhotons)
+            tagged.insert(tagged.end(), list.begin(), list.end());
+        std::stable_sort(tagged.begin(), tagged.end(), [](const std::pair<int, Photon> &a, const std::pair<int, Photon> &b) {
+            return a.first < b.first;
+        });
+        photonList.reserve(tagged.size());
+        for (auto &p : tagged)
+            photonList.push_back(p.second);
+
+        if (this->cache) this->cache->store(iter_, photonList);
+        out.map.set(photonList);
+        out.map.constructTree();
+    }
+
+    /**
+     * @note: Light tracing of caustics, i.e. a photon that only met specular surfaces
+     * before this diffuse one is connected to the camera. The photon map blurs these,
+     * so the eye pass skips caustic photons where the camera sees the surface directly.
+     */
+    void splatToCamera(const Hit &hit, const Vector3f &in, const Vector3f &power, SceneParser &parser, Sampler &reng, PhotonPass &target) {
+        const HitSurface &surface = hit.surface;
+        Camera *camera = parser.getCamera();
+
+        double px, py;
+        double importance = camera->sampleImportance(surface.position, px, py, reng);
+        if (importance <= 0) return;
+
+        Vector3f dir = camera->getCenter() - surface.position;
+        double dist = dir.length();
+        dir = dir / dist;
+
+        Vector3f x = surface.normal;
+        Vector3f y = Trans::generateVertical(x);
+        Vector3f z = Vector3f::cross(x, y).normalized();
+        Vector3f out = Trans::worldToLocal(y, z, x, dir);
+        Vector3f color = power * hit.material->shade(out, Trans::worldToLocal(y, z, x, in), false);
+        if (surface.hasTexture && hit.material->textured())
+            color = color * hit.material->getTexturePixel(surface.cord);
+
+        color = color * importance * std::abs(out[2]) / (dist * dist * target.photonNum);
+        if (!validVector(color) || color == Vector3f::ZERO) return;
+
+        // Shadow ray, the camera is not part of the scene
+        Hit block;
+        bool isLight;
+        int lightId;
+        if (parser.intersect(Ray(surface.position, dir), block, 1e-6, isLight, lightId) && block.t < dist - 1e-4)
+            return;
+
+        int i = std::min(camera->getWidth() - 1, std::max(0, (int) std::floor(px + .5)));
+        int j = std::min(camera->getHeight() - 1, std::max(0, (int) std::floor(py + .5)));
+        int index = 3 * (i + j * camera->getWidth());
+        for (int k = 0; k < 3; k++) {
+#pragma omp atomic
+            target.splat[index + k] += color[k];
+        }
+    }
+
+    Vector3f getRadiance(const Ray &r, SceneParser &parser, Sampler &reng) {
+        Hit hit;
+        bool isLight;
+        int lightId = 0;
+        bool found = parser.intersect(r, hit, 1e-6, isLight, lightId);
+        return this->getRadiance(r, hit, found, isLight, lightId, parser, reng);
     }
 
-    Vector3f getRadiance(const Ray &r, SceneParser &parser, RandomEngine &reng) {
+    // The same, from the first hit of r found by the caller
+    Vector3f getRadiance(const Ray &r, Hit hit, bool found, bool isLight, int lightId, SceneParser &parser, Sampler &reng) {
         Ray ray = r;
         Vector3f power(1, 1, 1);
 
         for (int depth = 0; depth < this->depth; depth++) {
-            Hit hit;
-            bool isLight;
-            int lightId = 0;
-            if (!parser.intersect(ray, hit, 1e-6, isLight, lightId))
+            if (depth > 0) {
+                hit = Hit();
+                lightId = 0;
+                found = parser.intersect(ray, hit, 1e-6, isLight, lightId);
+            }
+            if (!found)
                 return parser.getBackgroundColor();
 
             Vector3f dir = ray.d.normalized();
@@ -121,13 +450,17 @@ private:
             Vector3f x = surface.normal;
             Vector3f y = Trans::generateVertical(x);
             Vector3f z = Vector3f::cross(x, y).normalized();
+            reng.setDimension(EYE_DIM_BOUNCE + depth * EYE_DIM_PER_BOUNCE);
             auto res = material->getOutputRay(Trans::worldToLocal(y, z, x, -dir), false, reng);
 
             if (res.isDiffuse) {
+                bool skipCaustics = this->causticSplat && depth == 0;
+                Vector3f color = this->irradianceCache
+                    ? getGatherRadiance(dir, hit, parser, reng, skipCaustics, EYE_DIM_BOUNCE + depth * EYE_DIM_PER_BOUNCE)
+                    : getPhotonRadiance(dir, hit, parser, reng, skipCaustics);
                 if (isLight)
-                    return power * (getPhotonRadiance(dir, hit, parser, reng) 
-                        + parser.getLight(lightId)->getIllumin(dir) * std::abs(Vector3f::dot(dir, x)));
-                return power * getPhotonRadiance(dir, hit, parser, reng);
+                    color += parser.getLight(lightId)->getIllumin(dir) * std::abs(Vector3f::dot(dir, x));
+                return power * color;
             }
 
             if (surface.hasTexture && material->textured())
@@ -137,15 +470,335 @@ private:
             ray = Ray(surface.position, out);
             power = power * res.x * std::abs(Vector3f::dot(out, x)) / std::max(res.pdf, 1e-6);
             if (power.length() < 1e-5) break;
+
+            // Russian roulette on the path throughput
+            if (this->rouletteDepth >= 0 && depth >= this->rouletteDepth) {
+                double q = this->survival(power);
+                reng.setDimension(EYE_DIM_BOUNCE + depth * EYE_DIM_PER_BOUNCE + EYE_DIM_ROULETTE);
+                if (reng.getUniformDouble(0, 1) >= q) return Vector3f::ZERO;
+                power = power / q;
+            }
         }
         return power;
     }
 
-    Vector3f getPhotonRadiance(const Vector3f& v, const Hit& hit, SceneParser& parser, RandomEngine& reng) {
+    // Intersects the rays members of the slots as one packet, rayAt gives the ray of a slot
+    template <typename RayAt>
+    void intersectPacket(
+        const RayAt &rayAt, const std::vector<int> &members, SceneParser &parser,
+        std::vector<Hit> &hits, std::vector<char> &found, std::vector<char> &hitLight, std::vector<int> &hitLightId
+    ) {
+        int n = members.size();
+        std::vector<Ray> rays;
+        rays.reserve(n);
+        for (int r : members)
+            rays.push_back(rayAt(r));
+        std::vector<Hit> packetHits(n);
+        std::vector<char> packetFound(n, 0), packetLight(n, 0);
+        std::vector<int> packetLightId(n, 0);
+        parser.intersectPacket(rays.data(), packetHits.data(), packetFound.data(), packetLight.data(), packetLightId.data(), n, 1e-6);
+
+        for (int m = 0; m < n; m++) {
+            hits[members[m]] = packetHits[m];
+            found[members[m]] = packetFound[m];
+            hitLight[members[m]] = packetLight[m];
+            hitLightId[members[m]] = packetLightId[m];
+        }
+    }
+
+    /**
+     * @note: Intersects the camera rays of a tile as packets, one per sample index & block
+     * of pixels. Slots are the samples of the tile pixel by pixel, from firstSlot of each.
+     */
+    template <typename RayAt>
+    void intersectCameraRays(
+        const Tile &tile, const std::vector<int> &budget, int width, const std::vector<int> &firstSlot,
+        const RayAt &rayAt, SceneParser &parser,
+        std::vector<Hit> &hits, std::vector<char> &found, std::vector<char> &hitLight, std::vector<int> &hitLightId
+    ) {
+        int tileWidth = tile.x1 - tile.x0;
+        for (int by = tile.y0; by < tile.y1; by += PACKET_BLOCK)
+            for (int bx = tile.x0; bx < tile.x1; bx += PACKET_BLOCK)
+                for (int k = 0; ; k++) {
+                    std::vector<int> members;
+                    for (int j = by; j < std::min(by + PACKET_BLOCK, tile.y1); j++)
+                        for (int i = bx; i < std::min(bx + PACKET_BLOCK, tile.x1); i++)
+                            if (k < budget[i + j * width])
+                                members.push_back(firstSlot[(i - tile.x0) + (j - tile.y0) * tileWidth] + k);
+                    if (members.empty()) break;
+                    this->intersectPacket(rayAt, members, parser, hits, found, hitLight, hitLightId);
+                }
+    }
+
+    /**
+     * @note: Wavefront eye pass of a tile, the same samples as getRadiance. The camera
+     * rays are all generated first, then each bounce intersects the whole queue sorted
+     * by direction octant & shades it sorted by material. Diffuse hits are gathered last.
+     * Rays run out of order, so the sampler is restarted for each of them. The camera rays
+     * are intersected as packets, one per sample index & block of pixels.
+     */
+    void traceWavefront(const Tile &tile, int iter_, const std::vector<int> &budget, int width, SceneParser &parser, PixelSampler &reng, std::vector<Vector3f> &tileColor) {
+        // Generate, slots are the samples of the tile pixel by pixel
+        std::vector<int> slotX, slotY, slotK;
+        RayQueue queue, next;
+        int tileWidth = tile.x1 - tile.x0;
+        std::vector<int> firstSlot(tileWidth * (tile.y1 - tile.y0));
+        Camera *camera = parser.getCamera();
+        CameraBatch cameraRays(camera->hasLens());
+        for (int j = tile.y0; j < tile.y1; j++)
+            for (int i = tile.x0; i < tile.x1; i++) {
+                firstSlot[(i - tile.x0) + (j - tile.y0) * tileWidth] = slotK.size();
+                reng.startPixel(i, j, iter_);
+                for (int k = 0; k < budget[i + j * width]; k++) {
+                    reng.startSample(k);
+                    cameraRays.push(i, j, reng);
+                    slotX.push_back(i);
+                    slotY.push_back(j);
+                    slotK.push_back(k);
+                }
+            }
+        camera->generateRays(cameraRays);
+        for (int slot = 0; slot < cameraRays.size(); slot++)
+            queue.push(cameraRays.getRay(slot, camera->getCenter()), Vector3f(1, 1, 1), slot);
+        std::vector<Vector3f> result(slotK.size(), Vector3f::ZERO);
+
+        // Diffuse hits waiting to be gathered
+        struct Gather {
+            int slot, depth;
+            Hit hit;
+            Vector3f dir, power;
+            bool isLight;
+            int lightId;
+        };
+        std::vector<Gather> gathers;
+
+        std::vector<Material *> materials; // Seen so far, their index keys the shading order
+        for (int depth = 0; depth < this->depth && queue.size() > 0; depth++) {
+            // Extend
+            int n = queue.size();
+            std::vector<Hit> hits(n);
+            std::vector<char> found(n, 0), hitLight(n, 0);
+            std::vector<int> hitLightId(n, 0);
+            if (depth == 0) {
+                // Still in the order of the slots
+                this->intersectCameraRays(tile, budget, width, firstSlot, [&](int r) { return queue.getRay(r); },
+                    parser, hits, found, hitLight, hitLightId);
+            } else {
+                queue.permute(Wavefront::sortBy(n, 8, [&](int r) { return queue.getOctant(r); }));
+                for (int r = 0; r < n; r++) {
+                    bool isLight;
+                    found[r] = parser.intersect(queue.getRay(r), hits[r], 1e-6, isLight, hitLightId[r]);
+                    hitLight[r] = isLight;
+                }
+            }
+
+            // Shade, misses last
+            std::vector<int> kind(n);
+            for (int r = 0; r < n; r++) {
+                if (!found[r]) continue;
+                kind[r] = std::find(materials.begin(), materials.end(), hits[r].material) - materials.begin();
+                if (kind[r] == (int) materials.size()) materials.push_back(hits[r].material);
+            }
+            std::vector<int> order = Wavefront::sortBy(n, materials.size() + 1, [&](int r) {
+                return found[r] ? kind[r] : (int) materials.size();
+            });
+
+            next.clear();
+            for (int r : order) {
+                int slot = queue.slot[r];
+                if (!found[r]) {
+                    result[slot] = parser.getBackgroundColor();
+                    continue;
+                }
+
+                Vector3f dir = queue.getRay(r).d.normalized();
+                Vector3f power = queue.getPower(r);
+                const Hit &hit = hits[r];
+                Material* material = hit.material;
+                const HitSurface &surface = hit.surface;
+
+                Vector3f x = surface.normal;
+                Vector3f y = Trans::generateVertical(x);
+                Vector3f z = Vector3f::cross(x, y).normalized();
+                reng.startPixel(slotX[slot], slotY[slot], iter_);
+                reng.startSample(slotK[slot]);
+                reng.setDimension(EYE_DIM_BOUNCE + depth * EYE_DIM_PER_BOUNCE);
+                auto res = material->getOutputRay(Trans::worldToLocal(y, z, x, -dir), false, reng);
+
+                if (res.isDiffuse) {
+                    gathers.push_back(Gather { slot, depth, hit, dir, power, (bool) hitLight[r], hitLightId[r] });
+                    continue;
+                }
+
+                if (surface.hasTexture && material->textured())
+                    power = power * material->getTexturePixel(surface.cord);
+
+                Vector3f out = Trans::localToWorld(y, z, x, res.out);
+                power = power * res.x * std::abs(Vector3f::dot(out, x)) / std::max(res.pdf, 1e-6);
+                if (power.length() < 1e-5) {
+                    result[slot] = power;
+                    continue;
+                }
+
+                // Russian roulette on the path throughput
+                if (this->rouletteDepth >= 0 && depth >= this->rouletteDepth) {
+                    double q = this->survival(power);
+                    reng.setDimension(EYE_DIM_BOUNCE + depth * EYE_DIM_PER_BOUNCE + EYE_DIM_ROULETTE);
+                    if (reng.getUniformDouble(0, 1) >= q) continue;
+                    power = power / q;
+                }
+                next.push(Ray(surface.position, out), power, slot);
+            }
+            std::swap(queue, next);
+        }
+        for (int r = 0; r < queue.size(); r++)
+            result[queue.slot[r]] = queue.getPower(r); // Out of bounces
+
+        // Gather, in the order of the slots so that neighbour lookups follow each other
+        std::sort(gathers.begin(), gathers.end(), [](const Gather &a, const Gather &b) { return a.slot < b.slot; });
+        for (const Gather &g : gathers) {
+            reng.startPixel(slotX[g.slot], slotY[g.slot], iter_);
+            reng.startSample(slotK[g.slot]);
+            bool skipCaustics = this->causticSplat && g.depth == 0;
+            Vector3f color = this->irradianceCache
+                ? getGatherRadiance(g.dir, g.hit, parser, reng, skipCaustics, EYE_DIM_BOUNCE + g.depth * EYE_DIM_PER_BOUNCE)
+                : getPhotonRadiance(g.dir, g.hit, parser, reng, skipCaustics);
+            if (g.isLight)
+                color += parser.getLight(g.lightId)->getIllumin(g.dir) * std::abs(Vector3f::dot(g.dir, g.hit.surface.normal));
+            result[g.slot] = g.power * color;
+        }
+
+        for (int slot = 0; slot < (int) result.size(); slot++) {
+            if (!validVector(result[slot])) continue; // When radiance is invalid, pass it
+            tileColor[(slotX[slot] - tile.x0) + (slotY[slot] - tile.y0) * tileWidth] += result[slot];
+        }
+    }
+
+    /**
+     * @note: Samples of every pixel in the next iteration. A pixel whose relative standard
+     * error is below the threshold is retired, the others share the rays of a full
+     * iteration in proportion to their error. Returns the number of pixels left.
+     * The error is the one of the estimates of the iterations, as most of the noise
+     * comes from the photon map, which all the samples of an iteration share.
+     */
+    int allocateSamples(
+        const std::vector<double> &lumSum, const std::vector<double> &lumSqSum,
+        const std::vector<int> &iterCount, std::vector<int> &budget
+    ) const {
+        int pixelNum = budget.size();
+        std::vector<double> error(pixelNum, 0.);
+        double errorSum = 0.;
+        int active = 0;
+
+        for (int p = 0; p < pixelNum; p++) {
+            if (budget[p] == 0) continue; // Retired
+            if (iterCount[p] < 2) { // Not measured yet, keeps its samples
+                active++;
+                continue;
+            }
+            double mean = lumSum[p] / iterCount[p];
+            double variance = std::max(0., lumSqSum[p] / iterCount[p] - mean * mean) * iterCount[p] / (iterCount[p] - 1);
+            error[p] = std::sqrt(variance / iterCount[p]) / std::max(mean, ADAPTIVE_MIN_LUMINANCE);
+            if (error[p] < this->adaptiveThreshold) {
+                budget[p] = 0;
+                continue;
+            }
+            errorSum += error[p];
+            active++;
+        }
+
+        double rays = (double) this->rayNum * pixelNum;
+        for (int p = 0; p < pixelNum && errorSum > 0; p++) {
+            if (budget[p] == 0 || iterCount[p] < 2) continue;
+            int n = (int) std::lround(rays * error[p] / errorSum);
+            budget[p] = std::min(ADAPTIVE_MAX_FACTOR * this->rayNum, std::max(1, n));
+        }
+        return active;
+    }
+
+    // Set by SIGINT & SIGTERM, a second signal is not caught anymore
+    static volatile sig_atomic_t &stopFlag() {
+        static volatile sig_atomic_t flag = 0;
+        return flag;
+    }
+
+    static void onSignal(int sig) {
+        stopFlag() = 1;
+        std::signal(sig, SIG_DFL);
+    }
+
+    double getElapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - this->renderStart).count();
+    }
+
+    // Whether the current iteration should be dropped, on a signal or past the time budget
+    bool stopping() const {
+        return stopFlag() || (this->timeBudget > 0 && this->getElapsed() >= this->timeBudget);
+    }
+
+    // Cuts the photons per iteration so that TIME_MIN_ITER more iterations fit in the budget
+    void fitPhotons(double iterCost, double photonCost, int basePhotonNum) {
+        if (this->cache) return; // The cached maps hold basePhotonNum photons
+
+        double left = this->timeBudget - this->getElapsed();
+        if (left >= TIME_MIN_ITER * iterCost) return;
+
+        double eyeCost = iterCost - photonCost;
+        double perPhoton = photonCost / this->photonNum;
+        double fit = (left / TIME_MIN_ITER - eyeCost) / std::max(perPhoton, 1e-12);
+        this->photonNum = std::max(std::max(basePhotonNum / TIME_MAX_PHOTON_SCALE, 1), std::min(this->photonNum, (int) fit));
+        std::cout << "Time budget: " << this->photonNum << " photons per iteration" << std::endl;
+    }
+
+    // Fingerprint of what the accumulated state depends on, the iteration count aside
+    uint64_t getStateKey(SceneParser &parser, int width, int height) const {
+        uint64_t key = parser.getHash();
+        key = Hash::combine(key, parser.getCameraHash()); // Accumulators of another view do not mix
+        key = Hash::combine(key, width);
+        key = Hash::combine(key, height);
+        key = Hash::combine(key, this->photonNum);
+        key = Hash::combine(key, this->rayNum);
+        key = Hash::combine(key, this->depth);
+        key = Hash::combine(key, this->searchRadius);
+        key = Hash::combine(key, this->alpha);
+        key = Hash::combine(key, this->photonSampler);
+        key = Hash::combine(key, this->pixelSampler);
+        key = Hash::combine(key, this->rouletteDepth);
+        key = Hash::combine(key, this->rouletteMinSurvival);
+        key = Hash::combine(key, this->guideResolution);
+        key = Hash::combine(key, this->causticSplat);
+        key = Hash::combine(key, this->gatherNum);
+        key = Hash::combine(key, this->gatherAccuracy);
+        key = Hash::combine(key, this->adaptiveThreshold);
+        key = Hash::combine(key, this->adaptiveMinIter);
+        return key;
+    }
+
+    // Average of the samples & of the splats of the iterations done, gamma corrected
+    void resolve(const RenderState &state, SceneParser &parser, Image &image) const {
+        int width = image.getWidth();
+        for (int i = 0; i < image.getWidth(); i++)
+            for (int j = 0; j < image.getHeight(); j++) {
+                int index = i + j * width;
+                Vector3f splat(state.splat[3 * index], state.splat[3 * index + 1], state.splat[3 * index + 2]);
+                Vector3f color = state.img[index] / std::max(state.sampleCount[index], 1) + splat / std::max(state.iterDone, 1);
+                double maxColor = 1.;
+
+                // TODO: Understand operations here
+                for (int k = 0; k < 3; k++) {
+                    color[k] = std::pow(color[k], 1.0f / parser.getCamera()->getGamma());
+                    maxColor = std::max(maxColor, color[k]);
+                }
+                image.setPixel(i, j, color / maxColor);
+            }
+    }
+
+    // Density estimate of the caustic photons and / or the other ones around the hit, flat - in a disc
+    Vector3f estimatePhotons(const Vector3f& v, const Hit& hit, bool caustic, bool other, bool flat) {
         const HitSurface& surface = hit.surface;
         Material* material = hit.material;
 
-        std::vector<Photon *> res = gMap.IRSearch(surface.position, searchRadius * searchRadius);
+        std::vector<Photon *> res = this->photons->map.IRSearch(surface.position, searchRadius * searchRadius);
         Vector3f x = surface.normal;
         Vector3f y = Trans::generateVertical(x);
         Vector3f z = Vector3f::cross(x, y).normalized();
@@ -153,6 +806,11 @@ private:
 
         Vector3f color = Vector3f::ZERO;
         for (auto ph_ptr : res) {
+            if (ph_ptr->caustic ? !caustic : !other) continue;
+            if (flat && std::abs(Vector3f::dot(ph_ptr->pos - surface.position, x)) > GATHER_DISC_THICKNESS * searchRadius)
+                continue;
+            if (this->guide && ph_ptr->source >= 0)
+                this->guide->record(ph_ptr->source, 1.);
             color +=
                 ph_ptr->power * material->shade(
                     in,
@@ -163,90 +821,514 @@ private:
         if (surface.hasTexture && hit.material->textured())
             color = color * hit.material->getTexturePixel(surface.cord);
 
+        return color / (M_PI * searchRadius * searchRadius * this->photons->photonNum);
+    }
+
+    Vector3f getPhotonRadiance(const Vector3f& v, const Hit& hit, SceneParser& parser, Sampler& reng, bool skipCaustics) {
+        const HitSurface& surface = hit.surface;
+        Vector3f x = surface.normal;
+        Vector3f y = Trans::generateVertical(x);
+        Vector3f z = Vector3f::cross(x, y).normalized();
+        Vector3f in = Trans::worldToLocal(y, z, x, -v);
+
+        // Caustic photons may be splatted by the photon pass
         return (
-            color / (M_PI * searchRadius * searchRadius * photonNum) +
-            parser.getAmbient() * material->shade(in, Vector3f(0, 0, 1), false)
+            estimatePhotons(v, hit, !skipCaustics, true, false) +
+            parser.getAmbient() * hit.material->shade(in, Vector3f(0, 0, 1), false)
         );
     }
 
+    // Light reaching p from one sampled light, reflected along in
+    Vector3f sampleDirect(
+        const Vector3f &p, const Vector3f &in,
+        const Vector3f &x, const Vector3f &y, const Vector3f &z,
+        Material *material, SceneParser &parser, Sampler &reng
+    ) {
+        double lightPdf;
+        int lightId = parser.sampleLight(reng, lightPdf);
+        LightSample ls = parser.getLight(lightId)->sampleDirect(p, reng);
+        if (ls.pdf <= 0 || ls.radiance == Vector3f::ZERO) return Vector3f::ZERO;
+
+        Vector3f out = Trans::worldToLocal(y, z, x, ls.dir);
+        Vector3f f = material->shade(in, out, false);
+        if (f == Vector3f::ZERO) return Vector3f::ZERO;
+
+        // Shadow ray, the light itself stops it at dist
+        Hit hit;
+        bool isLight;
+        int hitLight;
+        if (parser.intersect(Ray(p, ls.dir), hit, 1e-6, isLight, hitLight) && hit.t < ls.dist - 1e-4)
+            return Vector3f::ZERO;
+
+        return f * ls.radiance * std::abs(out[2]) / (ls.pdf * lightPdf);
+    }
+
+    // Radiance found by a gather ray, from the photon map at its first diffuse hit
+    Vector3f traceGather(Ray ray, SceneParser &parser, Sampler &reng, double &dist) {
+        Vector3f power(1, 1, 1);
+        dist = INFINITY;
+
+        for (int dep = 0; dep < this->depth; dep++) {
+            Hit hit;
+            bool isLight;
+            int lightId;
+            if (!parser.intersect(ray, hit, 1e-6, isLight, lightId)) break;
+            if (dep == 0) dist = hit.t;
+
+            Vector3f dir = ray.d.normalized();
+            Material *material = hit.material;
+            HitSurface surface = hit.surface;
+
+            Vector3f x = surface.normal;
+            Vector3f y = Trans::generateVertical(x);
+            Vector3f z = Vector3f::cross(x, y).normalized();
+            reng.setDimension(2 + dep * EYE_DIM_PER_BOUNCE);
+            auto res = material->getOutputRay(Trans::worldToLocal(y, z, x, -dir), false, reng);
+
+            // Emission is left out, it is either sampled directly or a caustic
+            if (res.isDiffuse) return power * estimatePhotons(dir, hit, true, true, true);
+
+            if (surface.hasTexture && material->textured())
+                power = power * material->getTexturePixel(surface.cord);
+
+            Vector3f out = Trans::localToWorld(y, z, x, res.out);
+            ray = Ray(surface.position, out);
+            power = power * res.x * std::abs(Vector3f::dot(out, x)) / std::max(res.pdf, 1e-6);
+            if (power.length() < 1e-5) break;
+        }
+        return Vector3f::ZERO;
+    }
+
+    // Irradiance at p over the hemisphere of n, from stratified cosine distributed gather rays
+    Vector3f gatherIrradiance(const Vector3f &p, const Vector3f &n, SceneParser &parser, double &radius) {
+        Vector3f y = Trans::generateVertical(n);
+        Vector3f z = Vector3f::cross(n, y).normalized();
+
+        // The rays of a record only depend on its position
+        uint64_t key = Hash::OFFSET;
+        for (int k = 0; k < 3; k++)
+            key = Hash::combine(key, (double) p[k]);
+        CounterSampler reng(RNG_STREAM_GATHER);
+
+        int rows = std::max(1, (int) std::sqrt((double) this->gatherNum));
+        int cols = std::max(1, this->gatherNum / rows);
+        Vector3f sum = Vector3f::ZERO;
+        double inverseDist = 0.;
+
+        for (int k = 0; k < rows * cols; k++) {
+            reng.startStream(this->iteration, (uint32_t) key, (uint32_t) (key >> 32), k);
+            double t = std::sqrt((k / cols + reng.getUniformDouble(0, 1)) / rows);
+            double phi = 2. * M_PI * (k % cols + reng.getUniformDouble(0, 1)) / cols;
+            Vector3f out = Vector3f(std::sqrt(1. - t * t) * std::cos(phi), std::sqrt(1. - t * t) * std::sin(phi), t);
+
+            double dist;
+            sum += this->traceGather(Ray(p, Trans::localToWorld(y, z, n, out)), parser, reng, dist);
+            inverseDist += 1. / std::max(dist, 1e-6);
+        }
+
+        // Harmonic mean distance to the surroundings
+        radius = this->irradianceCache->clampRadius(inverseDist > 0 ? rows * cols / inverseDist : INFINITY);
+        return sum * M_PI / (rows * cols);
+    }
+
+    /**
+     * @note: Final gathering, i.e. the photon map is looked up one diffuse bounce away from
+     * the eye, where its blotches are blurred by the hemisphere integral. The irradiance is
+     * interpolated from the cache, light is sampled directly & caustics stay in the map.
+     */
+    Vector3f getGatherRadiance(const Vector3f& v, const Hit& hit, SceneParser& parser, Sampler& reng, bool skipCaustics, int dim) {
+        const HitSurface& surface = hit.surface;
+        Material* material = hit.material;
+
+        Vector3f x = surface.normal;
+        Vector3f y = Trans::generateVertical(x);
+        Vector3f z = Vector3f::cross(x, y).normalized();
+        Vector3f in = Trans::worldToLocal(y, z, x, -v);
+
+        Vector3f texture(1, 1, 1);
+        if (surface.hasTexture && material->textured())
+            texture = material->getTexturePixel(surface.cord);
+
+        // Irradiance of the side seen, computed & cached when no record is close enough
+        Vector3f n = in[2] >= 0 ? x : -x;
+        Vector3f irradiance;
+        if (!this->irradianceCache->lookup(surface.position, n, irradiance)) {
+            double radius;
+            irradiance = this->gatherIrradiance(surface.position, n, parser, radius);
+            this->irradianceCache->insert(surface.position, n, irradiance, radius);
+        }
+        Vector3f color = irradiance * material->shade(in, Vector3f(0, 0, in[2] >= 0 ? 1 : -1), false) * texture;
+
+        if (parser.getNumLights() > 0) {
+            reng.setDimension(dim + EYE_DIM_LIGHT);
+            color += this->sampleDirect(surface.position, in, x, y, z, material, parser, reng) * texture;
+        }
+        if (!skipCaustics)
+            color += estimatePhotons(v, hit, true, false, true);
+
+        return color + parser.getAmbient() * material->shade(in, Vector3f(0, 0, 1), false);
+    }
+
 public:
     SPPMRenderer(int n, int i, int d, int nrays, double r, double a)
-        : photonNum(n), iter(i), depth(d), rayNum(nrays), searchRadius(r), alpha(a) { }
-    
-    void render(SceneParser &parser, Image &image) {
-        std::vector<Vector3f> img(image.getHeight() * image.getWidth());
+        : photons(nullptr), guide(nullptr), guideResolution(0), guideUniformRatio(0.2), cache(nullptr),
+          causticSplat(false), gatherNum(0), gatherAccuracy(0.2), irradianceCache(nullptr),
+          iteration(0), adaptiveThreshold(0.), adaptiveMinIter(4),
+          snapshotPattern("tmp/%d.test.bmp"), snapshotInterval(1), snapshotSeconds(0.),
+          checkpointInterval(10), resume(false), wavefront(false), timeBudget(0.), scalePhotons(false),
+          photonSampler(SAMPLER_SOBOL),
+          photonNum(n), rayNum(nrays), iter(i), depth(d), searchRadius(r), alpha(a) { }
+
+    ~SPPMRenderer() {
+        if (this->guide) delete this->guide;
+        if (this->cache) delete this->cache;
+        if (this->irradianceCache) delete this->irradianceCache;
+    }
+
+    /**
+     * @note: Bias photon emission towards the directions whose photons are gathered
+     * by the eye pass. resolution is the size of the per light (u, v) grid.
+     */
+    void setAdaptiveEmission(int resolution, double uniformRatio = 0.2) {
+        this->guideResolution = resolution;
+        this->guideUniformRatio = uniformRatio;
+    }
+
+    /**
+     * @note: Photons of every iteration are stored into / loaded from this file,
+     * so that renders of the same scene from other cameras skip the photon pass.
+     */
+    void setPhotonCache(const std::string &filename) {
+        this->cacheFile = filename;
+    }
+
+    /**
+     * @note: Caustics seen directly by the camera are light traced by the photon pass
+     * & splatted, instead of being gathered from the photon map.
+     */
+    void setCausticSplat(bool enable) {
+        this->causticSplat = enable;
+    }
 
-        // Initialize random engines
-        std::vector<RandomEngine> rengList(omp_get_max_threads());
-        for (int i = 0; i < (int) rengList.size(); i++) {
-            rengList[i].setSeed(rengList[i].getUniformInt(0, rengList.size() - 1) + i * rengList.size());
+    /**
+     * @note: Final gathering with rays gather rays per irradiance record, instead of the
+     * photon map seen directly. accuracy is the largest error of the records interpolated.
+     */
+    void setFinalGather(int rays, double accuracy = 0.2) {
+        this->gatherNum = rays;
+        this->gatherAccuracy = accuracy;
+    }
+
+    /**
+     * @note: After minIter iterations, pixels whose relative standard error is below
+     * threshold stop being sampled & the rays of an iteration go to the noisiest ones.
+     */
+    void setAdaptiveSampling(double threshold, int minIter = 4) {
+        this->adaptiveThreshold = threshold;
+        this->adaptiveMinIter = std::max(2, minIter); // The variance needs two iterations
+    }
+
+    /**
+     * @note: Save the image every interval iterations (0 - never), at most once per
+     * minSeconds, into pattern where %d is the iteration.
+     */
+    void setSnapshots(const std::string &pattern, int interval, double minSeconds = 0.) {
+        this->snapshotPattern = pattern;
+        this->snapshotInterval = interval;
+        this->snapshotSeconds = minSeconds;
+    }
+
+    /**
+     * @note: Save the accumulated state into filename every interval iterations, when the
+     * render ends & when it is interrupted by SIGINT or SIGTERM. With resume, a render
+     * of the same scene & parameters goes on from the saved state, the adaptive emission
+     * guide excepted, which learns again.
+     */
+    void setCheckpoint(const std::string &filename, int interval, bool _resume) {
+        this->checkpointFile = filename;
+        this->checkpointInterval = interval;
+        this->resume = _resume;
+    }
+
+    /**
+     * @note: Render until seconds have passed since the render started, instead of iter
+     * iterations. An iteration is only started when the last one says it fits, & one
+     * overrunning the budget is dropped. With _scalePhotons, the photons per iteration
+     * are cut once timed, so that at least TIME_MIN_ITER iterations fit.
+     */
+    void setTimeBudget(double seconds, bool _scalePhotons = false) {
+        this->timeBudget = seconds;
+        this->scalePhotons = _scalePhotons;
+    }
+
+    /**
+     * @note: Trace the eye pass as a wavefront, each bounce of a whole tile at once, rays
+     * grouped by direction octant for the intersections & by material for the shading.
+     * Photons are traced in batches too, binned by origin cell & direction octant.
+     */
+    void setWavefront(bool enable) {
+        this->wavefront = enable;
+    }
+
+    void setPhotonSampler(SamplerType type) {
+        this->photonSampler = type;
+    }
+
+    virtual void render(SceneParser &parser, Image &image) override {
+        this->renderStart = std::chrono::steady_clock::now();
+        int width = image.getWidth(), height = image.getHeight();
+        int pixelNum = width * height;
+        TileScheduler scheduler(width, height);
+
+        // Row major as the image. Samples of every pixel in the next iteration & statistics
+        // of the luminance of its iterations
+        RenderState state;
+        state.nextIter = 0;
+        state.iterDone = 0;
+        state.searchRadius = this->searchRadius;
+        state.img.assign(pixelNum, Vector3f::ZERO);
+        state.splat.assign(3 * pixelNum, 0.);
+        state.budget.assign(pixelNum, this->rayNum);
+        state.sampleCount.assign(pixelNum, 0);
+        state.iterCount.assign(pixelNum, 0);
+        state.lumSum.assign(pixelNum, 0.);
+        state.lumSqSum.assign(pixelNum, 0.);
+        bool adaptive = this->adaptiveThreshold > 0;
+        int maxRays = adaptive ? ADAPTIVE_MAX_FACTOR * this->rayNum : this->rayNum;
+
+        uint64_t stateKey = this->getStateKey(parser, width, height);
+        if (this->resume && !this->checkpointFile.empty() && Checkpoint::load(this->checkpointFile, stateKey, state)) {
+            this->searchRadius = state.searchRadius;
+            printf("Resumed from %s at iteration %d\n", this->checkpointFile.c_str(), state.nextIter);
         }
 
-        for (int iter_ = 0; iter_ < this->iter; iter_++) {
+        // Initialize samplers, their numbers only depend on the pixel & the iteration
+        std::vector<PixelSampler *> pixelSamplerList(omp_get_max_threads());
+        for (int i = 0; i < (int) pixelSamplerList.size(); i++)
+            pixelSamplerList[i] = PixelSampler::create(this->pixelSampler, maxRays);
+
+        if (this->guide) delete this->guide;
+        this->guide = this->guideResolution > 0
+            ? new EmissionGuide(parser.getNumLights(), this->guideResolution, this->guideUniformRatio)
+            : nullptr;
+
+        if (this->cache) delete this->cache;
+        this->cache = nullptr;
+        if (!this->cacheFile.empty()) {
+            if (this->guide) {
+                // Guided photons depend on the camera, they cannot be shared
+                printf("Adaptive emission is view dependent, photon cache disabled\n");
+            } else if (this->causticSplat) {
+                // Splats are made while tracing, cached photons would skip them
+                printf("Caustic splatting traces the photons, photon cache disabled\n");
+            } else {
+                uint64_t key = parser.getHash();
+                key = Hash::combine(key, this->photonNum);
+                key = Hash::combine(key, this->depth);
+                key = Hash::combine(key, this->photonSampler);
+                key = Hash::combine(key, this->rouletteDepth);
+                key = Hash::combine(key, this->rouletteMinSurvival);
+                key = Hash::combine(key, this->causticSplat);
+                key = Hash::combine(key, this->gatherNum > 0); // Final gathering reads the caustic flags
+                this->cache = new PhotonCache(this->cacheFile.c_str(), key);
+            }
+        }
+
+        SnapshotWriter snapshots(this->snapshotPattern, this->snapshotInterval, this->snapshotSeconds);
+
+        // Preemption stops the render at the end of the last complete iteration
+        stopFlag() = 0;
+        void (*oldInt)(int) = std::signal(SIGINT, onSignal);
+        void (*oldTerm)(int) = std::signal(SIGTERM, onSignal);
+
+        // The radius only depends on the iterations done, so the count may be left open
+        int basePhotonNum = this->photonNum;
+        int maxIter = this->timeBudget > 0 ? INT_MAX : this->iter;
+        double iterCost = 0., photonCost = 0.; // Seconds of the last iteration & of its photon pass
+        int timed = 0;
+
+        /**
+         * @note: The photons of the next iteration are traced while the eye pass gathers
+         * the current ones, into a second buffer. Both passes spawn a full thread team,
+         * so the cores left idle by the tail of a pass & its tree build get the other one.
+         * Guided emission depends on the eye pass before, so it gets no lookahead.
+         */
+        std::unique_ptr<PhotonPass> current, next;
+        std::future<void> nextDone;
+        auto launch = [&](int iter_) {
+            next.reset(new PhotonPass());
+            next->iteration = iter_;
+            next->photonNum = this->photonNum;
+            next->splat.assign(3 * pixelNum, 0.);
+            next->seconds = 0.;
+            next->cancel = false;
+            PhotonPass *out = next.get();
+            nextDone = std::async(std::launch::async, [this, &parser, out]() {
+                double start = this->getElapsed();
+                this->buildPhotonMap(parser, *out);
+                out->seconds = this->getElapsed() - start;
+            });
+        };
+        bool lookahead = this->guide == nullptr;
+
+        std::vector<Vector3f> pass(pixelNum); // Samples of this iteration
+        for (int iter_ = state.nextIter; iter_ < maxIter; iter_++) {
+            // Costs only go down with the radius, so the last iteration is a safe guess
+            double iterStart = this->getElapsed();
+            if (this->timeBudget > 0 && iterStart + iterCost > this->timeBudget) break;
+
+            if (adaptive && iter_ >= this->adaptiveMinIter) {
+                int active = this->allocateSamples(state.lumSum, state.lumSqSum, state.iterCount, state.budget);
+                std::cout << "Adaptive sampling: " << active << " pixels left" << std::endl;
+                if (active == 0) break; // Converged
+            }
             std::cout << "Now at iteration: " << iter_ << std::endl;
 
-            this->buildPhotonMap(parser, rengList);
+            // Traced ahead with the photon count the time budget has changed since
+            if (!next || next->iteration != iter_ || next->photonNum != this->photonNum) {
+                if (nextDone.valid()) {
+                    next->cancel = true;
+                    nextDone.get();
+                }
+                launch(iter_);
+            }
+            nextDone.get();
+            current = std::move(next);
+            this->photons = current.get();
+            photonCost = current->seconds;
             std::cout << "Finish building Photon Map" << std::endl;
 
-            Image renderImg(image.getWidth(), image.getHeight()); 
-
-#pragma omp parallel for collapse(2) schedule(dynamic, 5)
-            // Traverse all the pixels
-            for (int i = 0; i < image.getWidth(); i++) {
-                for (int j = 0; j < image.getHeight(); j++) {
-                    RandomEngine& reng = rengList[omp_get_thread_num()];
-                    Vector3f color = Vector3f::ZERO;
-
-                    // Sample rays
-                    auto validVector = [&](const Vector3f &v) -> bool {
-                        return !(
-                            v[0] < 0 || std::isinf(v[0]) || std::isnan(v[0]) ||
-                            v[1] < 0 || std::isinf(v[1]) || std::isnan(v[1]) ||
-                            v[2] < 0 || std::isinf(v[2]) || std::isnan(v[2])
-                        );
-                    };
-
-                    for (int k = 0; k < this->rayNum; k++) {
-                        Ray camRay = parser.getCamera()->sampleRay(i, j, reng);
-                        Vector3f x = this->getRadiance(camRay, parser, reng);
-                        
-                        if (!validVector(x)) continue; // When radiance is invalid, pass it
-                        color += x;
-                    }
+            // The iterations timed for the photon scaling run alone
+            bool calibrating = this->timeBudget > 0 && this->scalePhotons && timed < TIME_CALIBRATION_ITER;
+            // Under a time budget, only when the next iteration should still fit
+            bool fits = this->timeBudget <= 0 || iterStart + 2 * iterCost <= this->timeBudget;
+            if (lookahead && !calibrating && fits && iter_ + 1 < maxIter) launch(iter_ + 1);
+
+            // The irradiances depend on the photon map, so the cache is rebuilt with it
+            if (this->irradianceCache) delete this->irradianceCache;
+            this->irradianceCache = this->gatherNum > 0
+                ? new IrradianceCache(this->gatherAccuracy, this->searchRadius, GATHER_MAX_RADIUS * this->searchRadius)
+                : nullptr;
+            this->iteration = iter_;
+
+            // Traverse all the pixels, tile by tile
+            scheduler.run([&](const Tile &tile, int thread) {
+                if (this->stopping()) return; // This iteration is dropped
 
-                    // Save the color into the result image
-                    img[j + i * image.getHeight()] += color / this->rayNum;
+                PixelSampler& reng = *pixelSamplerList[thread];
+                int tileWidth = tile.x1 - tile.x0;
+                std::vector<Vector3f> tileColor(tileWidth * (tile.y1 - tile.y0), Vector3f::ZERO);
 
-                    // Save this pass
-                    Vector3f colorTmp = img[j + i * image.getHeight()] / (iter_ + 1);
+                if (this->wavefront) {
+                    this->traceWavefront(tile, iter_, state.budget, width, parser, reng, tileColor);
+                } else {
+                    // Camera rays of the whole tile first, in the order they are traced
+                    Camera *camera = parser.getCamera();
+                    CameraBatch cameraRays(camera->hasLens());
+                    std::vector<int> firstSlot(tileWidth * (tile.y1 - tile.y0));
+                    for (int j = tile.y0; j < tile.y1; j++)
+                        for (int i = tile.x0; i < tile.x1; i++) {
+                            firstSlot[(i - tile.x0) + (j - tile.y0) * tileWidth] = cameraRays.size();
+                            reng.startPixel(i, j, iter_);
+                            for (int k = 0; k < state.budget[i + j * width]; k++) {
+                                reng.startSample(k);
+                                cameraRays.push(i, j, reng);
+                            }
+                        }
+                    camera->generateRays(cameraRays);
 
-                    double maxColor = 1.;
-                    for (int k = 0; k < 3; k++) {
-                        colorTmp[k] = std::pow(colorTmp[k], 1. / parser.getCamera()->getGamma());
-                        maxColor = std::max(maxColor, colorTmp[k]);
+                    // Then their first hits, as packets
+                    std::vector<Ray> rays;
+                    rays.reserve(cameraRays.size());
+                    for (int slot = 0; slot < cameraRays.size(); slot++)
+                        rays.push_back(cameraRays.getRay(slot, camera->getCenter()));
+                    std::vector<Hit> hits(rays.size());
+                    std::vector<char> found(rays.size(), 0), hitLight(rays.size(), 0);
+                    std::vector<int> hitLightId(rays.size(), 0);
+                    this->intersectCameraRays(tile, state.budget, width, firstSlot, [&](int r) { return rays[r]; },
+                        parser, hits, found, hitLight, hitLightId);
+
+                    int slot = 0;
+                    for (int j = tile.y0; j < tile.y1; j++) {
+                        for (int i = tile.x0; i < tile.x1; i++) {
+                            reng.startPixel(i, j, iter_);
+                            Vector3f color = Vector3f::ZERO;
+
+                            // Sample rays
+                            for (int k = 0; k < state.budget[i + j * width]; k++, slot++) {
+                                reng.startSample(k);
+                                Vector3f x = this->getRadiance(rays[slot], hits[slot], found[slot], hitLight[slot], hitLightId[slot], parser, reng);
+                            
+                                if (!validVector(x)) continue; // When radiance is invalid, pass it
+                                color += x;
+                            }
+                            tileColor[(i - tile.x0) + (j - tile.y0) * tileWidth] = color;
+                        }
                     }
+                }
+
+                for (int j = tile.y0; j < tile.y1; j++)
+                    for (int i = tile.x0; i < tile.x1; i++)
+                        pass[i + j * width] = tileColor[(i - tile.x0) + (j - tile.y0) * tileWidth];
+            });
+            if (this->stopping()) break;
 
-                    renderImg.setPixel(i, j, colorTmp / maxColor);
+            // Save the color into the result image
+            for (int index = 0; index < pixelNum; index++) {
+                int rays = state.budget[index];
+                state.img[index] += pass[index];
+                state.sampleCount[index] += rays;
+                for (int k = 0; k < 3; k++)
+                    state.splat[3 * index + k] += current->splat[3 * index + k];
+                if (rays > 0) {
+                    double lum = (pass[index][0] + pass[index][1] + pass[index][2]) / (3. * rays);
+                    state.lumSum[index] += lum;
+                    state.lumSqSum[index] += lum * lum;
+                    state.iterCount[index]++;
                 }
             }
 
-            // Save the temporary result & step the search radius
-            renderImg.saveBMP(("tmp/" + std::to_string(iter_) + ".test.bmp").c_str());
+            // Step the search radius
             searchRadius *= sqrt((iter_ + this->alpha) / (iter_ + 1));
+            if (this->guide) this->guide->update();
+            state.nextIter = iter_ + 1;
+            state.iterDone++;
+            state.searchRadius = this->searchRadius;
+
+            // Save the temporary result, the writer saves it in the background
+            if (snapshots.due(iter_)) {
+                Image *renderImg = new Image(width, height);
+                this->resolve(state, parser, *renderImg);
+                snapshots.push(iter_, renderImg);
+            }
+            if (!this->checkpointFile.empty() && this->checkpointInterval > 0 && state.nextIter % this->checkpointInterval == 0)
+                Checkpoint::save(this->checkpointFile, stateKey, state);
+
+            iterCost = this->getElapsed() - iterStart;
+            if (this->timeBudget > 0 && this->scalePhotons && ++timed == TIME_CALIBRATION_ITER)
+                this->fitPhotons(iterCost, photonCost, basePhotonNum);
         }
 
-        // Pass out the render result
-        for (int i = 0; i < image.getWidth(); i++)
-            for (int j = 0; j < image.getHeight(); j++) {
-                Vector3f color = img[j + i * image.getHeight()] / this->iter;
-                double maxColor = 1.;
+        if (nextDone.valid()) {
+            next->cancel = true;
+            nextDone.get();
+        }
+        this->photons = nullptr;
 
-                // TODO: Understand operations here
-                for (int k = 0; k < 3; k++) {
-                    color[k] = std::pow(color[k], 1.0f / parser.getCamera()->getGamma());
-                    maxColor = std::max(maxColor, color[k]);
-                }
-                image.setPixel(i, j, color / maxColor);
-            }
+        if (stopFlag())
+            printf("Interrupted, stopping after iteration %d\n", state.nextIter - 1);
+        else if (this->timeBudget > 0)
+            printf("Time budget reached after %d iterations, %.2lfs\n", state.iterDone, this->getElapsed());
+        this->photonNum = basePhotonNum;
+        if (!this->checkpointFile.empty())
+            Checkpoint::save(this->checkpointFile, stateKey, state);
+        std::signal(SIGINT, oldInt);
+        std::signal(SIGTERM, oldTerm);
+
+        for (auto sampler : pixelSamplerList)
+            delete sampler;
+
+        // Pass out the render result
+        this->resolve(state, parser, image);
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <vecmath.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Refinement parameters of the paper
+#define DTREE_MAX_DEPTH 20
+#define DTREE_SUBDIVIDE 0.01 // Quadrants holding more of the energy are split
+#define STREE_SPLIT 12000 // Records a spatial leaf needs to split, times sqrt(2^iteration)
+
+/**
+ * @note: Directional quadtree over the cylindrical coordinates (cos theta, phi) of the
+ * sphere. The mapping preserves area, so a uniform density on the square is 1 / 4pi.
+ * Every node keeps the energy recorded in its 4 quadrants.
+ */
+class DTree {
+private:
+    struct Node {
+        double sum[4];
+        int child[4]; // 0 - leaf
+    };
+
+    std::vector<Node> nodes;
+
+    static Node emptyNode() {
+        Node node;
+        for (int q = 0; q < 4; q++) {
+            node.sum[q] = 0.;
+            node.child[q] = 0;
+        }
+        return node;
+    }
+
+    // Quadrant of (u, v), which is moved into the quadrant coordinates
+    static int quadrant(double &u, double &v) {
+        int qx = u >= .5, qy = v >= .5;
+        u = std::min(2. * u - qx, 1.);
+        v = std::min(2. * v - qy, 1.);
+        return qx + 2 * qy;
+    }
+
+    static double total(const Node &node) {
+        return node.sum[0] + node.sum[1] + node.sum[2] + node.sum[3];
+    }
+
+    // Copies the structure & the energy, subdivided where it is large enough, energy is the one of the 4 quadrants
+    int build(DTree &tree, int old, const double energy[4], double all, int depth) const {
+        int index = tree.nodes.size();
+        tree.nodes.push_back(emptyNode());
+        for (int q = 0; q < 4; q++)
+            tree.nodes[index].sum[q] = energy[q];
+
+        for (int q = 0; q < 4; q++) {
+            if (depth >= DTREE_MAX_DEPTH || energy[q] <= DTREE_SUBDIVIDE * all) continue;
+
+            int oldChild = old >= 0 ? this->nodes[old].child[q] : 0;
+            double childEnergy[4];
+            for (int k = 0; k < 4; k++)
+                childEnergy[k] = oldChild ? this->nodes[oldChild].sum[k] : energy[q] / 4.;
+
+            int child = this->build(tree, oldChild ? oldChild : -1, childEnergy, all, depth + 1);
+            tree.nodes[index].child[q] = child;
+        }
+        return index;
+    }
+
+public:
+    DTree() {
+        this->nodes.push_back(emptyNode());
+    }
+
+    static Vector3f toDirection(double u, double v) {
+        double cosTheta = 2. * u - 1.;
+        double sinTheta = std::sqrt(std::max(0., 1. - cosTheta * cosTheta));
+        double phi = 2. * M_PI * v;
+        return Vector3f(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+    }
+
+    static void toSquare(const Vector3f &dir, double &u, double &v) {
+        double phi = std::atan2((double) dir[1], (double) dir[0]);
+        if (phi < 0) phi += 2. * M_PI;
+        u = std::min(std::max(.5 * (dir[2] + 1.), 0.), 1.);
+        v = std::min(phi / (2. * M_PI), 1.);
+    }
+
+    double getEnergy() const {
+        return total(this->nodes[0]);
+    }
+
+    // Safe to call from several threads
+    void record(const Vector3f &dir, double value) {
+        double u, v;
+        toSquare(dir, u, v);
+        int index = 0;
+        while (true) {
+            int q = quadrant(u, v);
+#pragma omp atomic
+            this->nodes[index].sum[q] += value;
+            if (this->nodes[index].child[q] == 0) break;
+            index = this->nodes[index].child[q];
+        }
+    }
+
+    // Solid angle density of sample
+    double getPdf(const Vector3f &dir) const {
+        double u, v;
+        toSquare(dir, u, v);
+        double pdf = 1. / (4. * M_PI);
+        int index = 0;
+        while (true) {
+            const Node &node = this->nodes[index];
+            double t = total(node);
+            if (t <= 0) break; // Uniform below
+
+            int q = quadrant(u, v);
+            pdf *= 4. * node.sum[q] / t;
+            if (node.child[q] == 0) break;
+            index = node.child[q];
+        }
+        return pdf;
+    }
+
+    // Direction from 2 uniform numbers, the quadrant choices reuse them
+    Vector3f sample(double u, double v) const {
+        double ox = 0., oy = 0., size = 1.;
+        int index = 0;
+        while (true) {
+            const Node &node = this->nodes[index];
+            double t = total(node);
+            if (t <= 0) break;
+
+            // Left or right half, then bottom or top quadrant of that half
+            double left = node.sum[0] + node.sum[2];
+            int qx = u >= left / t;
+            u = qx ? (u - left / t) / std::max(1. - left / t, 1e-12) : u / std::max(left / t, 1e-12);
+            double column = node.sum[qx] + node.sum[qx + 2];
+            double bottom = column > 0 ? node.sum[qx] / column : .5;
+            int qy = v >= bottom;
+            v = qy ? (v - bottom) / std::max(1. - bottom, 1e-12) : v / std::max(bottom, 1e-12);
+            u = std::min(u, 1.);
+            v = std::min(v, 1.);
+
+            size *= .5;
+            ox += qx * size;
+            oy += qy * size;
+            int q = qx + 2 * qy;
+            if (node.child[q] == 0) break;
+            index = node.child[q];
+        }
+        return toDirection(ox + u * size, oy + v * size);
+    }
+
+    /**
+     * @note: Tree holding the energy of this one, subdivided where it holds enough of it.
+     * Recording goes on into it, so every iteration is trained from all the previous ones,
+     * each weighted by its number of samples.
+     */
+    DTree refined() const {
+        DTree tree;
+        double all = this->getEnergy();
+        if (all <= 0) return tree;
+
+        tree.nodes.clear();
+        this->build(tree, 0, this->nodes[0].sum, all, 1);
+        return tree;
+    }
+
+    void scale(double factor) {
+        for (auto &node : this->nodes)
+            for (int q = 0; q < 4; q++)
+                node.sum[q] *= factor;
+    }
+};
+
+/**
+ * @ref: T. Müller et al. Practical Path Guiding for Efficient Light-Transport Simulation.
+ * Binary tree over space whose leaves hold a quadtree of the incident radiance. The quadtrees
+ * learnt up to an iteration are sampled in the next one, while recording goes on.
+ * Our scenes are unbounded (planes), so the box split by the tree is fitted to the records
+ * of the first iteration, records outside of it falling into the border leaves.
+ * Leaves split on the count of all their records, those that saw no radiance included.
+ * There is one tree per dominant axis of the normal, so that the two sides of a wall
+ * never share a leaf, whose quadtree would then send half of its samples into the wall.
+ */
+class SDTree {
+private:
+    struct Node {
+        Vector3f lo, hi;
+        int axis;
+        int child[2];
+        int leaf; // -1 - inner node
+    };
+
+    struct Leaf {
+        DTree sampling;
+        DTree building;
+        double count; // Records of the current iteration
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Leaf> leaves;
+
+    // Moments of the record positions, until the box is fitted
+    bool bounded;
+    double posCount;
+    double posSum[3];
+    double posSqSum[3];
+    double posMin[3], posMax[3];
+
+    // Root of the tree of the normal n, +x, -x, +y, -y, +z or -z
+    static int root(const Vector3f &n) {
+        int axis = std::abs(n[0]) >= std::abs(n[1]) && std::abs(n[0]) >= std::abs(n[2]) ? 0
+            : std::abs(n[1]) >= std::abs(n[2]) ? 1 : 2;
+        return 2 * axis + (n[axis] < 0);
+    }
+
+    int lookup(const Vector3f &p, const Vector3f &n) const {
+        int index = root(n);
+        while (this->nodes[index].leaf < 0) {
+            const Node &node = this->nodes[index];
+            double split = .5 * (node.lo[node.axis] + node.hi[node.axis]);
+            index = node.child[p[node.axis] >= split];
+        }
+        return this->nodes[index].leaf;
+    }
+
+    // Halves the leaf along its longest axis while it holds too many records
+    void subdivide(int index, double count, double threshold) {
+        if (count <= threshold) return;
+
+        Node node = this->nodes[index];
+        Vector3f size = node.hi - node.lo;
+        int axis = size[0] >= size[1] && size[0] >= size[2] ? 0 : size[1] >= size[2] ? 1 : 2;
+        double split = .5 * (node.lo[axis] + node.hi[axis]);
+
+        Node left = node, right = node;
+        left.hi[axis] = split;
+        right.lo[axis] = split;
+        right.leaf = this->leaves.size();
+        this->leaves[node.leaf].building.scale(.5); // The halves share the energy learnt so far
+        this->leaves.push_back(this->leaves[node.leaf]);
+
+        int child = this->nodes.size();
+        this->nodes.push_back(left);
+        this->nodes.push_back(right);
+        this->nodes[index].axis = axis;
+        this->nodes[index].child[0] = child;
+        this->nodes[index].child[1] = child + 1;
+        this->nodes[index].leaf = -1;
+
+        this->subdivide(child, .5 * count, threshold);
+        this->subdivide(child + 1, .5 * count, threshold);
+    }
+
+public:
+    SDTree() : bounded(false), posCount(0.) {
+        for (int i = 0; i < 6; i++) {
+            Node node;
+            node.lo = Vector3f(-1, -1, -1);
+            node.hi = Vector3f(1, 1, 1);
+            node.axis = 0;
+            node.child[0] = node.child[1] = 0;
+            node.leaf = i;
+            this->nodes.push_back(node);
+            this->leaves.push_back(Leaf { DTree(), DTree(), 0. });
+        }
+        for (int k = 0; k < 3; k++) {
+            this->posSum[k] = this->posSqSum[k] = 0.;
+            this->posMin[k] = INFINITY;
+            this->posMax[k] = -INFINITY;
+        }
+    }
+
+    const DTree &getSampling(const Vector3f &p, const Vector3f &n) const {
+        return this->leaves[this->lookup(p, n)].sampling;
+    }
+
+    // Radiance arriving at p (normal n) from dir over the density it was sampled with, thread safe
+    void record(const Vector3f &p, const Vector3f &n, const Vector3f &dir, double value) {
+        Leaf &leaf = this->leaves[this->lookup(p, n)];
+        if (value > 0) leaf.building.record(dir, value);
+#pragma omp atomic
+        leaf.count += 1.;
+
+        if (this->bounded) return;
+#pragma omp atomic
+        this->posCount += 1.;
+        for (int k = 0; k < 3; k++) {
+#pragma omp atomic
+            this->posSum[k] += p[k];
+#pragma omp atomic
+            this->posSqSum[k] += p[k] * p[k];
+        }
+#pragma omp critical(sd_tree_bounds)
+        for (int k = 0; k < 3; k++) {
+            this->posMin[k] = std::min(this->posMin[k], (double) p[k]);
+            this->posMax[k] = std::max(this->posMax[k], (double) p[k]);
+        }
+    }
+
+    // End of an iteration, the recorded quadtrees become the sampled ones
+    void update(int iteration) {
+        // Mean & 3 standard deviations, the far away records of open scenes are left out,
+        // within the records, which closed scenes keep to
+        if (!this->bounded && this->posCount > 0) {
+            for (int k = 0; k < 3; k++) {
+                double mean = this->posSum[k] / this->posCount;
+                double deviation = std::sqrt(std::max(this->posSqSum[k] / this->posCount - mean * mean, 1e-6));
+                for (int i = 0; i < 6; i++) {
+                    this->nodes[i].lo[k] = std::max(mean - 3. * deviation, this->posMin[k]);
+                    this->nodes[i].hi[k] = std::min(mean + 3. * deviation, this->posMax[k]);
+                }
+            }
+            this->bounded = true;
+        }
+
+        double threshold = STREE_SPLIT * std::sqrt(std::pow(2., iteration));
+        int nodeNum = this->nodes.size();
+        for (int i = 0; i < nodeNum; i++) {
+            if (this->nodes[i].leaf < 0) continue;
+
+            Leaf &leaf = this->leaves[this->nodes[i].leaf];
+            double count = leaf.count;
+            leaf.sampling = leaf.building;
+            leaf.building = leaf.building.refined();
+            leaf.count = 0.;
+            this->subdivide(i, count, threshold);
+        }
+    }
+};
@@ -0,0 +1,475 @@
+#pragma once
+
+#include "renderer/integrator.hpp"
+#include "renderer/ray.hpp"
+#include "renderer/hit.hpp"
+#include "photon/photon_map.hpp"
+#include "utils/counter_rng.hpp"
+#include "utils/trans.hpp"
+#include "utils/tile_scheduler.hpp"
+
+#include <vector>
+#include <omp.h>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+// Seed of the counter based generator of light sub paths
+#define RNG_STREAM_VCM_LIGHT 2
+
+// Sampler dimensions consumed along a light sub path
+#define VCM_DIM_LIGHT 0
+#define VCM_DIM_DIRECTION 2
+#define VCM_DIM_EMITTER 4
+#define VCM_DIM_BOUNCE 8
+#define VCM_DIM_PER_BOUNCE 6
+
+// Sampler dimensions consumed along a camera sub path, after the camera ones
+#define VCM_DIM_CAMERA_BOUNCE 4
+#define VCM_DIM_CAMERA_PER_BOUNCE 12
+#define VCM_DIM_NEE 6 // Offset inside a bounce, after the material ones
+
+/**
+ * @note: Non specular vertex of a sub path, with the partial MIS weights of the
+ * path leading to it. The frame is rebuilt from the normal as the other passes do.
+ */
+struct VCMVertex {
+    Vector3f position;
+    Vector3f normal;
+    Vector3f in; // Local direction towards the previous vertex
+    Material *material;
+    Vector3f texture;
+
+    Vector3f throughput;
+    int pathLength; // Segments from the sub path origin
+    double dVCM, dVC, dVM;
+
+    // BSDF towards the world direction dir, with the densities of sampling it from in & the other way round
+    Vector3f evaluate(const Vector3f &dir, double &cos_, double &dirPdf, double &revPdf) const {
+        Vector3f y = Trans::generateVertical(this->normal);
+        Vector3f z = Vector3f::cross(this->normal, y).normalized();
+        Vector3f out = Trans::worldToLocal(y, z, this->normal, dir);
+
+        cos_ = std::abs(out[2]);
+        dirPdf = this->material->getPdf(this->in, out);
+        revPdf = this->material->getPdf(out, this->in);
+        return this->material->shade(this->in, out, false) * this->texture;
+    }
+};
+
+/**
+ * @note: Vertex connection & merging, i.e. a bidirectional path tracer whose
+ * light vertices double as photons, all strategies weighted by the balance heuristic.
+ * Each iteration traces one light sub path & one camera sub path per pixel.
+ * @ref: I. Georgiev et al. Light Transport Simulation with Vertex Connection and Merging.
+ * @ref: https://github.com/SmallVCM/SmallVCM/blob/master/src/vertexcm.hxx
+ */
+class VCMIntegrator : public Integrator {
+private:
+    int iter;
+    int depth; // Maximum number of segments of a full path
+    double baseRadius;
+    double alpha;
+
+    // Per iteration constants
+    int lightPathNum;
+    double misVMWeight;
+    double misVCWeight;
+    double vmNormalization;
+
+    std::vector<VCMVertex> lightVertices;
+    std::vector<int> lightPathBegin; // Range of the vertices of each light sub path
+    PhotonMap vertexMap; // Light vertices by position, source is their index
+
+    struct PathState {
+        Vector3f origin;
+        Vector3f direction;
+        Vector3f throughput;
+        int pathLength;
+        double dVCM, dVC, dVM;
+    };
+
+    static bool visible(SceneParser &parser, const Vector3f &from, const Vector3f &dir, double dist) {
+        Hit hit;
+        bool isLight;
+        int lightId;
+        return !parser.intersect(Ray(from, dir), hit, 1e-6, isLight, lightId) || hit.t >= dist - 1e-4;
+    }
+
+    // Vertex at a surface hit, the MIS weights updated for the segment that reached it
+    VCMVertex makeVertex(const Hit &hit, const Vector3f &dir, PathState &state) {
+        const HitSurface &surface = hit.surface;
+        Vector3f x = surface.normal;
+        Vector3f y = Trans::generateVertical(x);
+        Vector3f z = Vector3f::cross(x, y).normalized();
+        Vector3f in = Trans::worldToLocal(y, z, x, -dir);
+
+        // All the lights have a position, the first segment counts as well
+        state.dVCM *= hit.t * hit.t;
+        double cos_ = std::max(std::abs(in[2]), 1e-6);
+        state.dVCM /= cos_;
+        state.dVC /= cos_;
+        state.dVM /= cos_;
+
+        Vector3f texture(1, 1, 1);
+        if (surface.hasTexture && hit.material->textured())
+            texture = hit.material->getTexturePixel(surface.cord);
+
+        return VCMVertex {
+            surface.position, x, in, hit.material, texture,
+            state.throughput, state.pathLength, state.dVCM, state.dVC, state.dVM,
+        };
+    }
+
+    // Continue the sub path from v, false once it is absorbed
+    bool scatter(const VCMVertex &v, bool fromLight, PathState &state, Sampler &reng) {
+        Vector3f x = v.normal;
+        Vector3f y = Trans::generateVertical(x);
+        Vector3f z = Vector3f::cross(x, y).normalized();
+
+        auto res = v.material->getOutputRay(v.in, fromLight, reng);
+        if (res.out == Vector3f::ZERO) return false;
+
+        double cosOut = std::abs(res.out[2]);
+        state.throughput = state.throughput * res.x * v.texture * cosOut / std::max(res.pdf, 1e-6);
+
+        if (!res.isDiffuse) {
+            state.dVCM = 0.;
+            state.dVC *= cosOut;
+            state.dVM *= cosOut;
+        } else {
+            double dirPdf = v.material->getPdf(v.in, res.out);
+            double revPdf = v.material->getPdf(res.out, v.in);
+            if (dirPdf <= 0) return false;
+            state.dVC = cosOut / dirPdf * (state.dVC * revPdf + state.dVCM + this->misVMWeight);
+            state.dVM = cosOut / dirPdf * (state.dVM * revPdf + state.dVCM * this->misVCWeight + 1.);
+            state.dVCM = 1. / dirPdf;
+        }
+
+        state.origin = v.position;
+        state.direction = Trans::localToWorld(y, z, x, res.out);
+        state.pathLength++;
+        return validVector(state.throughput) && state.throughput.length() > 1e-8;
+    }
+
+    // Light tracing, i.e. the vertex connected to the camera
+    void connectToCamera(const VCMVertex &v, SceneParser &parser, std::vector<double> &splat) {
+        Camera *camera = parser.getCamera();
+        double px, py;
+        if (!camera->project(v.position, px, py)) return;
+
+        Vector3f dir = camera->getCenter() - v.position;
+        double dist = dir.length();
+        dir = dir / dist;
+
+        double cos_, dirPdf, revPdf;
+        Vector3f f = v.evaluate(dir, cos_, dirPdf, revPdf);
+        if (f == Vector3f::ZERO) return;
+
+        double cameraPdfA = camera->getDirectionPdf(-dir) * cos_ / (dist * dist);
+        double wLight = cameraPdfA / this->lightPathNum * (this->misVMWeight + v.dVCM + v.dVC * revPdf);
+        Vector3f contrib = v.throughput * f * (cameraPdfA / this->lightPathNum / (wLight + 1.));
+        if (!validVector(contrib) || !visible(parser, v.position, dir, dist)) return;
+
+        int x = std::min(camera->getWidth() - 1, std::max(0, (int) std::floor(px + .5)));
+        int y = std::min(camera->getHeight() - 1, std::max(0, (int) std::floor(py + .5)));
+        int index = 3 * (x + y * camera->getWidth());
+        for (int k = 0; k < 3; k++) {
+#pragma omp atomic
+            splat[index + k] += contrib[k];
+        }
+    }
+
+    void traceLightPath(int id, SceneParser &parser, Sampler &reng, std::vector<std::pair<int, VCMVertex>> &vertices, std::vector<double> &splat) {
+        if (parser.getNumLights() == 0) return;
+
+        reng.setDimension(VCM_DIM_LIGHT);
+        double lightPdf;
+        int lightId = parser.sampleLight(reng, lightPdf);
+        Light *light = parser.getLight(lightId);
+
+        reng.setDimension(VCM_DIM_DIRECTION);
+        double u = reng.getUniformDouble(0, 1);
+        double v = reng.getUniformDouble(0, 1);
+        reng.setDimension(VCM_DIM_EMITTER);
+        auto result = light->sampleRay(u, v, reng);
+        if (result.pdf <= 0) return;
+
+        // Densities used by the weights go through the same approximation as the camera side
+        double emissionPdf = lightPdf * light->getEmissionPdf(result.ray.o, result.normal, result.ray.d);
+        double directPdf = lightPdf * light->getAreaPdf();
+        if (emissionPdf <= 0) return;
+
+        PathState state;
+        state.origin = result.ray.o;
+        state.direction = result.ray.d;
+        state.throughput = result.power / (result.pdf * lightPdf);
+        state.pathLength = 1;
+        state.dVCM = directPdf / emissionPdf;
+        state.dVC = light->isDelta() ? 0. : std::abs(Vector3f::dot(result.normal, result.ray.d)) / emissionPdf;
+        state.dVM = state.dVC * this->misVCWeight;
+
+        for (int dep = 0; state.pathLength < this->depth; dep++) {
+            Hit hit;
+            bool isLight;
+            int hitLight;
+            if (!parser.intersect(Ray(state.origin, state.direction), hit, 1e-6, isLight, hitLight)) break;
+
+            VCMVertex vertex = this->makeVertex(hit, state.direction, state);
+            if (!vertex.material->isSpecular()) {
+                vertices.push_back(std::make_pair(id, vertex));
+                this->connectToCamera(vertex, parser, splat);
+            }
+
+            reng.setDimension(VCM_DIM_BOUNCE + dep * VCM_DIM_PER_BOUNCE);
+            if (!this->scatter(vertex, true, state, reng)) break;
+        }
+    }
+
+    // Next event estimation from a camera vertex
+    Vector3f connectToLight(const VCMVertex &v, const PathState &state, SceneParser &parser, Sampler &reng) {
+        double lightPdf;
+        int lightId = parser.sampleLight(reng, lightPdf);
+        Light *light = parser.getLight(lightId);
+
+        LightSample ls = light->sampleDirect(v.position, reng);
+        if (ls.pdf <= 0 || ls.radiance == Vector3f::ZERO) return Vector3f::ZERO;
+
+        double cosToLight, dirPdf, revPdf;
+        Vector3f f = v.evaluate(ls.dir, cosToLight, dirPdf, revPdf);
+        if (f == Vector3f::ZERO) return Vector3f::ZERO;
+
+        double cosAtLight = light->isDelta() ? 1. : std::abs(Vector3f::dot(ls.normal, ls.dir));
+        double directPdf = light->getAreaPdf() * ls.dist * ls.dist / std::max(cosAtLight, 1e-6);
+        double emissionPdf = light->getEmissionPdf(ls.position, ls.normal, -ls.dir);
+
+        double wLight = light->isDelta() ? 0. : dirPdf / (lightPdf * directPdf);
+        double wCamera = emissionPdf * cosToLight / (directPdf * cosAtLight)
+            * (this->misVMWeight + state.dVCM + state.dVC * revPdf);
+
+        if (!visible(parser, v.position, ls.dir, ls.dist)) return Vector3f::ZERO;
+        return f * ls.radiance * (cosToLight / (ls.pdf * lightPdf) / (wLight + 1. + wCamera));
+    }
+
+    // Connect a camera vertex to every vertex of the light sub path of the same index
+    Vector3f connectVertices(const VCMVertex &v, const PathState &state, int pathId, SceneParser &parser) {
+        Vector3f result = Vector3f::ZERO;
+        for (int i = this->lightPathBegin[pathId]; i < this->lightPathBegin[pathId + 1]; i++) {
+            const VCMVertex &lv = this->lightVertices[i];
+            if (lv.pathLength + state.pathLength + 1 > this->depth) break;
+
+            Vector3f dir = lv.position - v.position;
+            double dist = dir.length();
+            if (dist < 1e-6) continue;
+            dir = dir / dist;
+
+            double cosCamera, cameraDirPdf, cameraRevPdf;
+            Vector3f fc = v.evaluate(dir, cosCamera, cameraDirPdf, cameraRevPdf);
+            if (fc == Vector3f::ZERO) continue;
+
+            double cosLight, lightDirPdf, lightRevPdf;
+            Vector3f fl = lv.evaluate(-dir, cosLight, lightDirPdf, lightRevPdf);
+            if (fl == Vector3f::ZERO) continue;
+
+            double g = cosLight * cosCamera / (dist * dist);
+            double cameraDirPdfA = cameraDirPdf * cosLight / (dist * dist);
+            double lightDirPdfA = lightDirPdf * cosCamera / (dist * dist);
+
+            double wLight = cameraDirPdfA * (this->misVMWeight + lv.dVCM + lv.dVC * lightRevPdf);
+            double wCamera = lightDirPdfA * (this->misVMWeight + state.dVCM + state.dVC * cameraRevPdf);
+
+            if (!visible(parser, v.position, dir, dist)) continue;
+            result += lv.throughput * fc * fl * (g / (wLight + 1. + wCamera));
+        }
+        return result;
+    }
+
+    // Photon density estimation with the light vertices around a camera vertex
+    Vector3f mergeVertices(const VCMVertex &v, const PathState &state, double radius) {
+        Vector3f result = Vector3f::ZERO;
+        std::vector<Photon *> found = this->vertexMap.IRSearch(v.position, radius * radius);
+        for (auto ph_ptr : found) {
+            const VCMVertex &lv = this->lightVertices[ph_ptr->source];
+            if (lv.pathLength + state.pathLength > this->depth) continue;
+
+            double cos_, dirPdf, revPdf;
+            Vector3f fc = v.evaluate(ph_ptr->direction, cos_, dirPdf, revPdf);
+            if (fc == Vector3f::ZERO) continue;
+
+            double wLight = lv.dVCM * this->misVCWeight + lv.dVM * dirPdf;
+            double wCamera = state.dVCM * this->misVCWeight + state.dVM * revPdf;
+            result += lv.throughput * fc / (wLight + 1. + wCamera);
+        }
+        return result * this->vmNormalization;
+    }
+
+    Vector3f traceCameraPath(const Ray &r, int pathId, double radius, SceneParser &parser, Sampler &reng) {
+        Camera *camera = parser.getCamera();
+
+        PathState state;
+        state.origin = r.o;
+        state.direction = r.d;
+        state.throughput = Vector3f(1, 1, 1);
+        state.pathLength = 1;
+        state.dVCM = this->lightPathNum / std::max(camera->getDirectionPdf(r.d), 1e-12);
+        state.dVC = state.dVM = 0.;
+
+        Vector3f radiance = Vector3f::ZERO;
+        bool ambient = false;
+        for (int dep = 0; state.pathLength <= this->depth; dep++) {
+            Hit hit;
+            bool isLight;
+            int lightId = 0;
+            if (!parser.intersect(Ray(state.origin, state.direction), hit, 1e-6, isLight, lightId))
+                return radiance + state.throughput * parser.getBackgroundColor();
+
+            Vector3f dir = state.direction;
+            VCMVertex vertex = this->makeVertex(hit, dir, state);
+
+            // Emission found by the camera sub path
+            if (isLight && Vector3f::dot(dir, hit.surface.normal) < 0) {
+                Light *light = parser.getLight(lightId);
+                double weight = 1.;
+                if (state.pathLength > 1) {
+                    double lightPdf = parser.getLightPdf(lightId);
+                    double directPdf = lightPdf * light->getAreaPdf();
+                    double emissionPdf = lightPdf * light->getEmissionPdf(hit.surface.position, hit.surface.normal, -dir);
+                    weight = 1. / (1. + directPdf * state.dVCM + emissionPdf * state.dVC);
+                }
+                radiance += state.throughput * light->getIllumin(dir) * weight;
+            }
+            if (state.pathLength >= this->depth) break;
+
+            int base = VCM_DIM_CAMERA_BOUNCE + dep * VCM_DIM_CAMERA_PER_BOUNCE;
+            if (!vertex.material->isSpecular()) {
+                // Ambient term, once per path as the SPPM eye pass does
+                if (!ambient) {
+                    radiance += state.throughput * parser.getAmbient()
+                        * vertex.material->shade(vertex.in, Vector3f(0, 0, 1), false) * vertex.texture;
+                    ambient = true;
+                }
+
+                if (parser.getNumLights() > 0) {
+                    reng.setDimension(base + VCM_DIM_NEE);
+                    radiance += state.throughput * this->connectToLight(vertex, state, parser, reng);
+                }
+                radiance += state.throughput * this->connectVertices(vertex, state, pathId, parser);
+                radiance += state.throughput * this->mergeVertices(vertex, state, radius);
+            }
+
+            reng.setDimension(base);
+            if (!this->scatter(vertex, false, state, reng)) break;
+        }
+        return radiance;
+    }
+
+public:
+    VCMIntegrator(int i, int d, double r, double a)
+        : iter(i), depth(d), baseRadius(r), alpha(a), lightPathNum(0),
+          misVMWeight(0), misVCWeight(0), vmNormalization(0) { }
+
+    virtual void render(SceneParser &parser, Image &image) override {
+        Camera *camera = parser.getCamera();
+        if (camera->getDirectionPdf(camera->getDirection()) <= 0) {
+            printf("VCM needs a camera supporting projection\n");
+            return;
+        }
+
+        int width = image.getWidth(), height = image.getHeight();
+        this->lightPathNum = width * height;
+
+        std::vector<Vector3f> img(width * height); // Row major as the image
+        std::vector<double> splat(3 * width * height, 0.);
+        TileScheduler scheduler(width, height);
+
+        std::vector<PixelSampler *> pixelSamplerList(omp_get_max_threads());
+        for (int i = 0; i < (int) pixelSamplerList.size(); i++)
+            pixelSamplerList[i] = PixelSampler::create(this->pixelSampler, this->iter); // One camera ray per iteration
+
+        for (int iter_ = 0; iter_ < this->iter; iter_++) {
+            std::cout << "Now at iteration: " << iter_ << std::endl;
+
+            double radius = this->baseRadius / std::pow(iter_ + 1., .5 * (1. - this->alpha));
+            double eta = M_PI * radius * radius * this->lightPathNum;
+            this->misVMWeight = eta;
+            this->misVCWeight = 1. / eta;
+            this->vmNormalization = 1. / eta;
+
+            // Light sub paths, their vertices sorted by path so that the result does not depend on the schedule
+            std::vector<std::vector<std::pair<int, VCMVertex>>> threadVertices(omp_get_max_threads());
+#pragma omp parallel for schedule(dynamic, 100)
+            for (int id = 0; id < this->lightPathNum; id++) {
+                CounterSampler reng(RNG_STREAM_VCM_LIGHT);
+                reng.startStream(iter_, id, 0, 0);
+                this->traceLightPath(id, parser, reng, threadVertices[omp_get_thread_num()], splat);
+            }
+
+            std::vector<std::pair<int, VCMVertex>> tagged;
+            for (auto &list : threadVertices)
+                tagged.insert(tagged.end(), list.begin(), list.end());
+            std::stable_sort(tagged.begin(), tagged.end(), [](const std::pair<int, VCMVertex> &a, const std::pair<int, VCMVertex> &b) {
+                return a.first < b.first;
+            });
+
+            this->lightVertices.clear();
+            this->lightPathBegin.assign(this->lightPathNum + 1, 0);
+            std::vector<Photon> photonList;
+            photonList.reserve(tagged.size());
+            for (auto &p : tagged) {
+                this->lightPathBegin[p.first + 1]++;
+                const VCMVertex &v = p.second;
+                Vector3f y = Trans::generateVertical(v.normal);
+                Vector3f z = Vector3f::cross(v.normal, y).normalized();
+                photonList.push_back(Photon {
+                    v.position, Trans::localToWorld(y, z, v.normal, v.in), v.throughput, (int) this->lightVertices.size(), false
+                });
+                this->lightVertices.push_back(v);
+            }
+            for (int i = 0; i < this->lightPathNum; i++)
+                this->lightPathBegin[i + 1] += this->lightPathBegin[i];
+            this->vertexMap.set(photonList);
+            this->vertexMap.constructTree();
+            std::cout << "Finish tracing " << this->lightVertices.size() << " light vertices" << std::endl;
+
+            // Camera sub paths, connected & merged with the light ones
+            scheduler.run([&](const Tile &tile, int thread) {
+                PixelSampler& reng = *pixelSamplerList[thread];
+                int tileWidth = tile.x1 - tile.x0;
+                std::vector<Vector3f> tileColor(tileWidth * (tile.y1 - tile.y0));
+
+                for (int j = tile.y0; j < tile.y1; j++) {
+                    for (int i = tile.x0; i < tile.x1; i++) {
+                        // The iterations are the samples of a single pixel sequence, so that they stratify
+                        reng.startPixel(i, j, 0);
+                        reng.startSample(iter_);
+
+                        Ray camRay = camera->sampleRay(i, j, reng);
+                        Vector3f x = this->traceCameraPath(camRay, i + j * width, radius, parser, reng);
+                        if (validVector(x))
+                            tileColor[(i - tile.x0) + (j - tile.y0) * tileWidth] = x;
+                    }
+                }
+
+                for (int j = tile.y0; j < tile.y1; j++)
+                    for (int i = tile.x0; i < tile.x1; i++)
+                        img[i + j * width] += tileColor[(i - tile.x0) + (j - tile.y0) * tileWidth];
+            });
+        }
+
+        for (auto sampler : pixelSamplerList)
+            delete sampler;
+
+        // Pass out the render result
+        for (int i = 0; i < width; i++)
+            for (int j = 0; j < height; j++) {
+                int index = i + j * width;
+                Vector3f color = (img[index] + Vector3f(splat[3 * index], splat[3 * index + 1], splat[3 * index + 2])) / this->iter;
+                double maxColor = 1.;
+                for (int k = 0; k < 3; k++) {
+                    color[k] = std::pow(color[k], 1. / camera->getGamma());
+                    maxColor = std::max(maxColor, color[k]);
+                }
+                image.setPixel(i, j, color / maxColor);
+            }
+    }
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vecmath.h>
+#include <vector>
+
+#include "renderer/ray.hpp"
+
+#define PACKET_BLOCK 8 // Camera rays of a sample index in PACKET_BLOCK x PACKET_BLOCK pixels form a packet
+
+/**
+ * @note: Rays in flight of a wavefront, one array per component so that a stage only
+ * streams through the ones it reads. Every ray carries the sample slot it adds to.
+ */
+class RayQueue {
+public:
+    std::vector<double> ox, oy, oz;
+    std::vector<double> dx, dy, dz; // Normalized
+    std::vector<double> pr, pg, pb; // Throughput
+    std::vector<int> slot;
+
+    int size() const {
+        return this->slot.size();
+    }
+
+    void clear() {
+        this->ox.clear(); this->oy.clear(); this->oz.clear();
+        this->dx.clear(); this->dy.clear(); this->dz.clear();
+        this->pr.clear(); this->pg.clear(); this->pb.clear();
+        this->slot.clear();
+    }
+
+    void push(const Ray &ray, const Vector3f &power, int s) {
+        this->ox.push_back(ray.o[0]); this->oy.push_back(ray.o[1]); this->oz.push_back(ray.o[2]);
+        this->dx.push_back(ray.d[0]); this->dy.push_back(ray.d[1]); this->dz.push_back(ray.d[2]);
+        this->pr.push_back(power[0]); this->pg.push_back(power[1]); this->pb.push_back(power[2]);
+        this->slot.push_back(s);
+    }
+
+    Ray getRay(int i) const {
+        Vector3f d(this->dx[i], this->dy[i], this->dz[i]);
+        Ray ray(Vector3f(this->ox[i], this->oy[i], this->oz[i]), d);
+        ray.d = d; // Normalized already, kept bit exact
+        return ray;
+    }
+
+    Vector3f getPower(int i) const {
+        return Vector3f(this->pr[i], this->pg[i], this->pb[i]);
+    }
+
+    // Sign bits of the direction, rays of one octant visit the tree nodes in the same order
+    int getOctant(int i) const {
+        return (this->dx[i] < 0) | ((this->dy[i] < 0) << 1) | ((this->dz[i] < 0) << 2);
+    }
+
+    // The i-th ray becomes the order[i]-th one
+    void permute(const std::vector<int> &order) {
+        permute(this->ox, order); permute(this->oy, order); permute(this->oz, order);
+        permute(this->dx, order); permute(this->dy, order); permute(this->dz, order);
+        permute(this->pr, order); permute(this->pg, order); permute(this->pb, order);
+        permute(this->slot, order);
+    }
+
+    template <typename T>
+    static void permute(std::vector<T> &values, const std::vector<int> &order) {
+        std::vector<T> sorted(values.size());
+        for (int i = 0; i < (int) order.size(); i++)
+            sorted[i] = values[order[i]];
+        values.swap(sorted);
+    }
+};
+
+class Wavefront {
+public:
+    // Indices [0, n) stably sorted by key(i), a counting sort as keys are in [0, keyNum)
+    template <typename Key>
+    static std::vector<int> sortBy(int n, int keyNum, Key key) {
+        std::vector<int> keys(n), start(keyNum + 1, 0);
+        for (int i = 0; i < n; i++) {
+            keys[i] = key(i);
+            start[keys[i] + 1]++;
+        }
+        for (int k = 0; k < keyNum; k++)
+            start[k + 1] += start[k];
+
+        std::vector<int> order(n);
+        for (int i = 0; i < n; i++)
+            order[start[keys[i]]++] = i;
+        return order;
+    }
+};
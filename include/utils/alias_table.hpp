@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "utils/sampler.hpp"
+
+/**
+ * @ref: A. J. Walker. An Efficient Method for Generating Discrete Random Variables with General Distributions.
+ * Samples index i with probability weights[i] / sum(weights) in O(1) time.
+ */
+class AliasTable {
+private:
+    std::vector<double> prob; // Probability to keep the picked bucket
+    std::vector<int> alias; // Bucket to take otherwise
+    std::vector<double> pdf;
+
+public:
+    AliasTable() = default;
+
+    AliasTable(const std::vector<double> &weights) {
+        int n = weights.size();
+        this->prob.assign(n, 1.);
+        this->alias.assign(n, 0);
+        this->pdf.assign(n, n > 0 ? 1. / n : 0.);
+        if (n == 0) return;
+
+        double total = 0.;
+        for (double w : weights)
+            total += std::max(w, 0.);
+        if (total <= 0.) return; // Degenerate weights, fall back to uniform
+
+        // Scaled probabilities, split into small & large buckets
+        std::vector<double> scaled(n);
+        std::vector<int> small, large;
+        for (int i = 0; i < n; i++) {
+            this->pdf[i] = std::max(weights[i], 0.) / total;
+            scaled[i] = this->pdf[i] * n;
+            (scaled[i] < 1. ? small : large).push_back(i);
+        }
+
+        while (!small.empty() && !large.empty()) {
+            int s = small.back(); small.pop_back();
+            int l = large.back(); large.pop_back();
+            this->prob[s] = scaled[s];
+            this->alias[s] = l;
+            scaled[l] -= 1. - scaled[s];
+            (scaled[l] < 1. ? small : large).push_back(l);
+        }
+
+        // Leftovers are 1 up to rounding errors
+        for (int i : small) this->prob[i] = 1.;
+        for (int i : large) this->prob[i] = 1.;
+    }
+
+    int size() const { return this->prob.size(); }
+
+    double getPdf(int i) const { return this->pdf[i]; }
+
+    int sample(Sampler &reng) const {
+        int n = this->prob.size();
+        double x = reng.getUniformDouble(0, n);
+        int i = std::min((int) x, n - 1);
+        return (x - i) < this->prob[i] ? i : this->alias[i];
+    }
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+
+#include "utils/sampler.hpp"
+
+/**
+ * @ref: J. Salmon et al. Parallel Random Numbers: As Easy as 1, 2, 3.
+ * Philox4x32-10, a stateless bijection from a 128 bits counter to 4 random words.
+ */
+class Philox {
+private:
+    static const uint32_t M0 = 0xd2511f53u;
+    static const uint32_t M1 = 0xcd9e8d57u;
+    static const uint32_t W0 = 0x9e3779b9u;
+    static const uint32_t W1 = 0xbb67ae85u;
+
+public:
+    static void generate(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]) {
+        uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int round = 0; round < 10; round++) {
+            uint64_t p0 = (uint64_t) M0 * c0;
+            uint64_t p1 = (uint64_t) M1 * c2;
+            uint32_t n0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+            uint32_t n2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+            c1 = (uint32_t) p1;
+            c3 = (uint32_t) p0;
+            c0 = n0;
+            c2 = n2;
+            k0 += W0;
+            k1 += W1;
+        }
+        out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+    // 53 bits double in [0, 1) from two words
+    static double toDouble(uint32_t a, uint32_t b) {
+        return ((a >> 5) * 67108864. + (b >> 6)) * (1. / 9007199254740992.);
+    }
+};
+
+/**
+ * @note: Sampler without running state. The value of a dimension only depends on
+ * (seed, iteration, stream, dimension), so a path draws the same numbers whichever
+ * thread traces it & in whatever order.
+ */
+class CounterSampler : public Sampler {
+private:
+    uint32_t key[2];
+    uint32_t stream[3];
+    uint32_t dimension;
+
+public:
+    CounterSampler(uint32_t seed = 0) : dimension(0) {
+        this->key[0] = 0;
+        this->key[1] = seed;
+        this->stream[0] = this->stream[1] = this->stream[2] = 0;
+    }
+
+    // E.g. (iteration, x, y, sample) for eye paths or (iteration, photon id, 0, 0) for photons
+    void startStream(uint32_t iteration, uint32_t a, uint32_t b, uint32_t c) {
+        this->key[0] = iteration;
+        this->stream[0] = a;
+        this->stream[1] = b;
+        this->stream[2] = c;
+        this->dimension = 0;
+    }
+
+    virtual void setDimension(int dim) override {
+        this->dimension = dim;
+    }
+
+    virtual double getUniformDouble(double min, double max) override {
+        uint32_t ctr[4] = { this->dimension++, this->stream[0], this->stream[1], this->stream[2] };
+        uint32_t out[4];
+        Philox::generate(ctr, this->key, out);
+        return min + (max - min) * Philox::toDouble(out[0], out[1]);
+    }
+
+};
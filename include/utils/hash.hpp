@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @note: 64-bit FNV-1a, used to fingerprint scenes & render parameters in cache files.
+ */
+class Hash {
+public:
+    static const uint64_t OFFSET = 14695981039346656037ULL;
+
+    static uint64_t fnv1a(const void *data, size_t len, uint64_t h = OFFSET) {
+        const unsigned char *p = (const unsigned char *) data;
+        for (size_t i = 0; i < len; i++) {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    template <typename T>
+    static uint64_t combine(uint64_t h, const T &value) {
+        return fnv1a(&value, sizeof(T), h);
+    }
+};
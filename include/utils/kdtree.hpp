@@ -72,9 +72,10 @@ private:
             result, target, d_sq
         );
 
+        // The other side, also when the target lies right on the splitting plane
         if (d_sq > directionDiff * directionDiff)
             searchInRange(
-                directionDiff > 0 ? now->left : now->right,
+                directionDiff < 0 ? now->right : now->left,
                 result, target, d_sq
             );
     }
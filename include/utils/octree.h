@@ -14,6 +14,9 @@
 #define MAX_TRI_IN_A_BOX 16
 #define MAX_TREE_DEPTH 8
 
+#define PACKET_MIN_RAYS 4 // Below this many rays in a node, they are traced alone
+#define PACKET_EPSILON 1e-6
+
 struct TriangleInfo;
 class Mesh;
 
@@ -25,6 +28,14 @@ struct OctNode {
     OctNode *child[8];
 };
 
+// Conservative bounds of the rays of a packet
+struct PacketBounds {
+    double oLo[3], oHi[3]; // Origins
+    double invLo[3], invHi[3]; // Inverse directions
+    int sign[3]; // Of the directions, 0 - mixed
+    double tMax; // Farthest current hit
+};
+
 class Octree {
 private:
     OctNode *root;
@@ -34,6 +45,17 @@ private:
     OctNode *build(Mesh *mesh, BBox *bbox, const std::vector<int> &ids, int depth);
 
     bool traverseIntersect(const Mesh *mesh, OctNode* node, const Ray &r, Hit &h, float tmin) const;
+
+    // Interval arithmetic test of the whole packet against the node
+    bool packetMayHit(const OctNode *node, const PacketBounds &bounds, double tmin) const;
+
+    bool rayMayHit(const OctNode *node, const Ray &r, double tmin, double tmax) const;
+
+    // scratch holds n ray ids per depth below node, bounds.tMax shrinks as hits are found
+    void traversePacket(
+        const Mesh *mesh, const OctNode *node, const Ray *rays, Hit *hits, char *found,
+        const int *active, int activeNum, PacketBounds bounds, float tmin, int *scratch, int n
+    ) const;
 public:
     Octree() = delete;
 
@@ -42,4 +64,11 @@ public:
     ~Octree();
 
     bool intersect(const Mesh *mesh, const Ray &r, Hit &h, float tmin) const;
+
+    /**
+     * @note: Coherent rays traversed together, found[i] is set when rays[i] hits the mesh
+     * closer than hits[i]. The packet is culled by its bounds against each node once, rays
+     * are tested alone below, & the rays left in a node go on alone once too few.
+     */
+    void intersectPacket(const Mesh *mesh, const Ray *rays, Hit *hits, char *found, int n, float tmin) const;
 };
\ No newline at end of file
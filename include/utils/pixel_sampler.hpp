@@ -0,0 +1,259 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+
+#include "utils/sampler.hpp"
+#include "utils/random_engine.hpp"
+#include "utils/counter_rng.hpp"
+
+// Dimensions driven by pixel samplers: subpixel offset, lens, then the first bounce
+#define PIXEL_SAMPLER_DIMS 10
+
+enum PixelSamplerType {
+    PIXEL_SAMPLER_RANDOM,
+    PIXEL_SAMPLER_STRATIFIED,
+    PIXEL_SAMPLER_SOBOL,
+    PIXEL_SAMPLER_BLUE_NOISE,
+};
+
+/**
+ * @note: Samples of one pixel. Call startPixel once per pixel & iteration,
+ * then startSample for each camera ray. Dimensions past PIXEL_SAMPLER_DIMS
+ * come from a counter based generator keyed by (iteration, pixel, sample).
+ */
+class PixelSampler : public Sampler {
+protected:
+    CounterSampler rng;
+    int x, y, iteration;
+    int dimension;
+
+    virtual double sample(int dim) = 0;
+
+public:
+    PixelSampler()
+        : x(0), y(0), iteration(0), dimension(0) { }
+
+    virtual void startPixel(int _x, int _y, int _iteration) {
+        this->x = _x;
+        this->y = _y;
+        this->iteration = _iteration;
+    }
+
+    virtual void startSample(int k) {
+        this->rng.startStream(this->iteration, this->x, this->y, k);
+        this->dimension = 0;
+    }
+
+    virtual void setDimension(int dim) override {
+        this->dimension = dim;
+    }
+
+    virtual double getUniformDouble(double min, double max) override {
+        int dim = this->dimension++;
+        if (dim >= PIXEL_SAMPLER_DIMS) {
+            this->rng.setDimension(dim);
+            return this->rng.getUniformDouble(min, max);
+        }
+        return min + (max - min) * this->sample(dim);
+    }
+
+    static PixelSampler *create(PixelSamplerType type, int sampleNum);
+};
+
+class RandomPixelSampler : public PixelSampler {
+protected:
+    virtual double sample(int dim) override {
+        this->rng.setDimension(dim);
+        return this->rng.getUniformDouble(0, 1);
+    }
+};
+
+/**
+ * @note: Jittered strata per dimension pair. Each pair uses its own random
+ * assignment of samples to strata, so pairs do not correlate.
+ */
+class StratifiedPixelSampler : public PixelSampler {
+private:
+    int sampleNum;
+    int nx, ny;
+    uint32_t seed;
+    int k;
+
+protected:
+    virtual double sample(int dim) override {
+        uint32_t pairSeed = SamplerUtils::hash(this->seed, dim >> 1);
+        int stratum = SamplerUtils::permute(this->k, nx * ny, pairSeed);
+        double jitter = SamplerUtils::toUnit(SamplerUtils::hash(SamplerUtils::hash(pairSeed, this->k), dim));
+        return (dim & 1)
+            ? (stratum / nx + jitter) / ny
+            : (stratum % nx + jitter) / nx;
+    }
+
+public:
+    StratifiedPixelSampler(int _sampleNum)
+        : sampleNum(_sampleNum), seed(0), k(0) {
+        this->nx = std::max(1, (int) std::sqrt((double) _sampleNum));
+        this->ny = (_sampleNum + this->nx - 1) / this->nx;
+    }
+
+    virtual void startPixel(int _x, int _y, int _iteration) override {
+        PixelSampler::startPixel(_x, _y, _iteration);
+        this->seed = SamplerUtils::hash(SamplerUtils::hash(_x, _y), _iteration);
+    }
+
+    virtual void startSample(int _k) override {
+        PixelSampler::startSample(_k);
+        this->k = _k;
+    }
+};
+
+// Owen-scrambled (0, 2)-sequence per pixel, scrambled independently for each pixel & iteration
+class SobolPixelSampler : public PixelSampler {
+private:
+    SobolSampler sobol;
+
+protected:
+    virtual double sample(int dim) override {
+        this->sobol.setDimension(dim);
+        return this->sobol.getUniformDouble(0, 1);
+    }
+
+public:
+    SobolPixelSampler()
+        : sobol(0) { }
+
+    virtual void startPixel(int _x, int _y, int _iteration) override {
+        PixelSampler::startPixel(_x, _y, _iteration);
+        this->sobol = SobolSampler(SamplerUtils::hash(SamplerUtils::hash(_x, _y), _iteration));
+    }
+
+    virtual void startSample(int k) override {
+        PixelSampler::startSample(k);
+        this->sobol.startSample(k);
+    }
+};
+
+/**
+ * @ref: I. Georgiev, M. Fajardo. Blue-noise Dithered Sampling.
+ * All pixels share one Sobol sequence per iteration, toroidally shifted by a
+ * blue-noise mask, so that the remaining error is spread as high frequency noise.
+ */
+class BlueNoisePixelSampler : public PixelSampler {
+private:
+    SobolSampler sobol;
+
+    static const int MASK_SIZE = 64;
+
+    /**
+     * @ref: R. Ulichney. The void-and-cluster method for dither array generation.
+     * Built once, values are the ranks of the pixels scaled into [0, 1).
+     */
+    static const std::vector<double> &mask() {
+        static std::vector<double> table;
+        if (!table.empty()) return table;
+
+        const int n = MASK_SIZE * MASK_SIZE;
+        const double sigma = 1.5;
+        std::vector<double> kernel(n);
+        for (int dy = 0; dy < MASK_SIZE; dy++)
+            for (int dx = 0; dx < MASK_SIZE; dx++) {
+                int tx = std::min(dx, MASK_SIZE - dx), ty = std::min(dy, MASK_SIZE - dy);
+                kernel[dy * MASK_SIZE + dx] = std::exp(-(tx * tx + ty * ty) / (2 * sigma * sigma));
+            }
+
+        std::vector<char> pattern(n, 0);
+        std::vector<double> energy(n, 0.);
+        auto toggle = [&](int p, bool on) {
+            pattern[p] = on;
+            int px = p % MASK_SIZE, py = p / MASK_SIZE;
+            for (int q = 0; q < n; q++) {
+                int dx = (q % MASK_SIZE - px + MASK_SIZE) % MASK_SIZE;
+                int dy = (q / MASK_SIZE - py + MASK_SIZE) % MASK_SIZE;
+                energy[q] += (on ? 1 : -1) * kernel[dy * MASK_SIZE + dx];
+            }
+        };
+        // Tightest cluster among ones, or largest void among zeros
+        auto extreme = [&](bool ones) {
+            int best = -1;
+            for (int q = 0; q < n; q++)
+                if (pattern[q] == ones && (best < 0 || (ones ? energy[q] > energy[best] : energy[q] < energy[best])))
+                    best = q;
+            return best;
+        };
+
+        // Initial pattern: 10% random points, relaxed until stable
+        RandomEngine reng(0);
+        int ones = n / 10;
+        for (int placed = 0; placed < ones; ) {
+            int p = reng.getUniformInt(0, n - 1);
+            if (!pattern[p]) { toggle(p, true); placed++; }
+        }
+        while (true) {
+            int cluster = extreme(true);
+            toggle(cluster, false);
+            int hole = extreme(false);
+            if (hole == cluster) { toggle(cluster, true); break; }
+            toggle(hole, true);
+        }
+
+        table.assign(n, 0.);
+        std::vector<char> initial(pattern);
+        std::vector<double> initialEnergy(energy);
+
+        // Phase 1, remove clusters from the initial pattern
+        for (int rank = ones - 1; rank >= 0; rank--) {
+            int cluster = extreme(true);
+            toggle(cluster, false);
+            table[cluster] = rank;
+        }
+
+        // Phase 2 & 3, fill the voids
+        pattern = initial;
+        energy = initialEnergy;
+        for (int rank = ones; rank < n; rank++) {
+            int hole = extreme(false);
+            toggle(hole, true);
+            table[hole] = rank;
+        }
+
+        for (double &v : table) v = (v + .5) / n;
+        return table;
+    }
+
+protected:
+    virtual double sample(int dim) override {
+        uint32_t h = SamplerUtils::hash(dim);
+        int mx = (this->x + (h & 0xffff)) % MASK_SIZE;
+        int my = (this->y + (h >> 16)) % MASK_SIZE;
+
+        this->sobol.setDimension(dim);
+        double v = this->sobol.getUniformDouble(0, 1) + mask()[my * MASK_SIZE + mx];
+        return v >= 1. ? v - 1. : v;
+    }
+
+public:
+    BlueNoisePixelSampler()
+        : sobol(0) {
+        mask();
+    }
+
+    virtual void startPixel(int _x, int _y, int _iteration) override {
+        PixelSampler::startPixel(_x, _y, _iteration);
+        this->sobol = SobolSampler(SamplerUtils::hash(_iteration));
+    }
+
+    virtual void startSample(int k) override {
+        PixelSampler::startSample(k);
+        this->sobol.startSample(k);
+    }
+};
+
+inline PixelSampler *PixelSampler::create(PixelSamplerType type, int sampleNum) {
+    switch (type) {
+        case PIXEL_SAMPLER_STRATIFIED: return new StratifiedPixelSampler(sampleNum);
+        case PIXEL_SAMPLER_SOBOL: return new SobolPixelSampler();
+        case PIXEL_SAMPLER_BLUE_NOISE: return new BlueNoisePixelSampler();
+        default: return new RandomPixelSampler();
+    }
+}
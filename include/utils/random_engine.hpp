@@ -3,10 +3,12 @@
 #include <random>
 #include <vector>
 
+#include "utils/sampler.hpp"
+
 /**
  * @ref: https://github.com/Numendacil/Graphics/blob/master/include/utils.hpp
  */
-class RandomEngine {
+class RandomEngine : public Sampler {
 private:
     std::mt19937 mt;
     unsigned int seed;
@@ -24,9 +26,12 @@ public:
 
     unsigned int getSeed() { return this->seed; }
 
-    void setSeed(unsigned int _seed) { this->seed = _seed; }
+    void setSeed(unsigned int _seed) {
+        this->seed = _seed;
+        this->mt.seed(this->seed);
+    }
 
-    double getUniformDouble(double min, double max) {
+    virtual double getUniformDouble(double min, double max) override {
         std::uniform_real_distribution<double> urd(min, max);
         return urd(this->mt);
     }
@@ -40,7 +45,7 @@ public:
         return result;
     }
 
-    int getUniformInt(int min, int max) {
+    virtual int getUniformInt(int min, int max) override {
         std::uniform_int_distribution<int> uid(min, max);
         return uid(this->mt);
     }
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+/**
+ * @note: Source of the uniform numbers consumed by lights, materials & objects.
+ * A sampler hands out one dimension per call; quasi Monte Carlo samplers
+ * derive it from (sample index, dimension) instead of a running state.
+ */
+class Sampler {
+public:
+    virtual ~Sampler() = default;
+
+    virtual double getUniformDouble(double min, double max) = 0;
+
+    virtual int getUniformInt(int min, int max) {
+        int n = max - min + 1;
+        return min + std::min((int) (this->getUniformDouble(0, 1) * n), n - 1);
+    }
+
+    // Jump to the given dimension of the current sample, no-op for pseudo random samplers
+    virtual void setDimension(int dim) { }
+};
+
+class SamplerUtils {
+public:
+    static uint32_t reverseBits(uint32_t x) {
+        x = (x << 16) | (x >> 16);
+        x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+        x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+        x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+        x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+        return x;
+    }
+
+    static uint32_t hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    static uint32_t hash(uint32_t a, uint32_t b) {
+        return hash(a ^ (hash(b) + 0x9e3779b9u + (a << 6) + (a >> 2)));
+    }
+
+    /**
+     * @ref: B. Burley. Practical Hash-based Owen Scrambling.
+     */
+    static uint32_t owenScramble(uint32_t x, uint32_t seed) {
+        x = reverseBits(x);
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return reverseBits(x);
+    }
+
+    /**
+     * @ref: A. Kensler. Correlated Multi-Jittered Sampling.
+     * Element i of a random permutation of [0, l) picked by p.
+     */
+    static uint32_t permute(uint32_t i, uint32_t l, uint32_t p) {
+        uint32_t w = l - 1;
+        w |= w >> 1;
+        w |= w >> 2;
+        w |= w >> 4;
+        w |= w >> 8;
+        w |= w >> 16;
+        do {
+            i ^= p; i *= 0xe170893du;
+            i ^= p >> 16;
+            i ^= (i & w) >> 4;
+            i ^= p >> 8; i *= 0x0929eb3fu;
+            i ^= p >> 23;
+            i ^= (i & w) >> 1; i *= 1 | p >> 27;
+            i *= 0x6935fa69u;
+            i ^= (i & w) >> 11; i *= 0x74dcb303u;
+            i ^= (i & w) >> 2; i *= 0x9e501cc3u;
+            i ^= (i & w) >> 2; i *= 0xc860a3dfu;
+            i &= w;
+            i ^= i >> 5;
+        } while (i >= l);
+        return (i + p) % l;
+    }
+
+    static double toUnit(uint32_t x) {
+        return std::min(x * 2.3283064365386963e-10, 1. - 1e-12); // x / 2^32
+    }
+};
+
+/**
+ * @note: Halton sequence, one prime base per dimension, randomized by a
+ * Cranley-Patterson rotation derived from the seed (e.g. the iteration).
+ * Dimensions past the prime table fall back to hashed random numbers.
+ */
+class HaltonSampler : public Sampler {
+private:
+    uint32_t seed;
+    uint64_t index;
+    int dimension;
+
+    static const int MAX_DIMENSION = 128;
+
+    static const std::vector<int> &primes() {
+        static std::vector<int> table;
+        if (table.empty()) {
+            for (int n = 2; (int) table.size() < MAX_DIMENSION; n++) {
+                bool prime = true;
+                for (int p : table) {
+                    if (p * p > n) break;
+                    if (n % p == 0) { prime = false; break; }
+                }
+                if (prime) table.push_back(n);
+            }
+        }
+        return table;
+    }
+
+    static double radicalInverse(int base, uint64_t a) {
+        double invBase = 1. / base, invBaseN = 1.;
+        uint64_t reversed = 0;
+        while (a) {
+            uint64_t next = a / base;
+            reversed = reversed * base + (a - next * base);
+            invBaseN *= invBase;
+            a = next;
+        }
+        return std::min(reversed * invBaseN, 1. - 1e-12);
+    }
+
+public:
+    HaltonSampler(uint32_t _seed)
+        : seed(_seed), index(0), dimension(0) {
+        primes();
+    }
+
+    void startSample(uint64_t _index) {
+        this->index = _index;
+        this->dimension = 0;
+    }
+
+    virtual void setDimension(int dim) override {
+        this->dimension = dim;
+    }
+
+    virtual double getUniformDouble(double min, double max) override {
+        int dim = this->dimension++;
+        double x;
+        if (dim < MAX_DIMENSION) {
+            double offset = SamplerUtils::toUnit(SamplerUtils::hash(this->seed, dim));
+            x = radicalInverse(primes()[dim], this->index) + offset;
+            if (x >= 1.) x -= 1.;
+        } else {
+            x = SamplerUtils::toUnit(SamplerUtils::hash(SamplerUtils::hash(this->seed, dim), (uint32_t) this->index));
+        }
+        return min + (max - min) * x;
+    }
+};
+
+/**
+ * @note: Padded Owen-scrambled Sobol sequence. Consecutive dimension pairs are the
+ * first two Sobol dimensions, i.e. a (0, 2)-sequence, with the sample index
+ * shuffled & every dimension scrambled independently per (seed, pair).
+ */
+class SobolSampler : public Sampler {
+private:
+    uint32_t seed;
+    uint32_t index;
+    int dimension;
+
+    static uint32_t sobol(uint32_t a, int dim) {
+        if (dim == 0) return SamplerUtils::reverseBits(a);
+
+        // Second Sobol dimension, direction numbers v_k = v_(k-1) ^ (v_(k-1) >> 1)
+        uint32_t v = 1u << 31, result = 0;
+        for (; a; a >>= 1, v ^= v >> 1)
+            if (a & 1) result ^= v;
+        return result;
+    }
+
+public:
+    SobolSampler(uint32_t _seed)
+        : seed(_seed), index(0), dimension(0) { }
+
+    void startSample(uint64_t _index) {
+        this->index = (uint32_t) _index;
+        this->dimension = 0;
+    }
+
+    virtual void setDimension(int dim) override {
+        this->dimension = dim;
+    }
+
+    virtual double getUniformDouble(double min, double max) override {
+        int dim = this->dimension++;
+        uint32_t pairSeed = SamplerUtils::hash(this->seed, dim >> 1);
+        uint32_t shuffled = SamplerUtils::owenScramble(this->index, pairSeed);
+        uint32_t x = SamplerUtils::owenScramble(
+            sobol(shuffled, dim & 1),
+            SamplerUtils::hash(pairSeed, dim & 1)
+        );
+        return min + (max - min) * SamplerUtils::toUnit(x);
+    }
+};
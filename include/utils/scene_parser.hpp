@@ -12,6 +12,8 @@
 #include "geometry/sphere.hpp"
 #include "geometry/transform.hpp"
 #include "geometry/triangle.hpp"
+#include "utils/alias_table.hpp"
+#include "utils/hash.hpp"
 
 #define MAX_PARSER_TOKEN_LENGTH 1024
 
@@ -25,6 +27,7 @@ private:
 
     int numLights;
     Light **lights;
+    AliasTable lightTable; // Lights weighted by their power
 
     int numMaterials;
     Material **materials;
@@ -32,7 +35,12 @@ private:
 
     Group *group;
 
+    uint64_t sceneHash;
+    uint64_t cameraHash;
+
     void parseFile();
+    void hashFile(const char *filename);
+    static uint64_t hashContent(const std::string &path, uint64_t h, int depth);
 
     void parsePerspectiveCamera();
     void parseLensCamera();
@@ -93,6 +101,17 @@ public:
 		return lights[i];
 	}
 
+	// Pick a light with probability proportional to its power
+	int sampleLight(Sampler &reng, double &pdf) const {
+		int i = lightTable.sample(reng);
+		pdf = lightTable.getPdf(i);
+		return i;
+	}
+
+	double getLightPdf(int i) const {
+		return lightTable.getPdf(i);
+	}
+
 	int getNumMaterials() const {
 		return numMaterials;
 	}
@@ -106,13 +125,44 @@ public:
 		return group;
 	}
 
+	// Fingerprint of everything but the camera, i.e. whatever the photon pass depends on
+	uint64_t getHash() const {
+		return sceneHash;
+	}
+
+	// Fingerprint of the camera block, what the eye pass adds to the one of the scene
+	uint64_t getCameraHash() const {
+		return cameraHash;
+	}
+
 	bool intersect(const Ray &r, Hit &h, double tmin, bool& isLight, int& LightIdx) const {
 		bool objIntersect = group->intersect(r, h, tmin);
 		isLight = false;
 		for (int i = 0; i < numLights; i++) {
-			isLight |= lights[i]->intersect(r, h, tmin);
-			if (isLight) LightIdx = i;
+			// Only a closer hit counts, the last light hit is the nearest one
+			if (lights[i]->intersect(r, h, tmin)) {
+				isLight = true;
+				LightIdx = i;
+			}
+		}
+		if (!(isLight | objIntersect)) return false;
+		h.computeSurface(r); // Of the closest hit only
+		return true;
+	}
+
+	// Closest hits of coherent rays, traced together through the objects that support it
+	void intersectPacket(const Ray *rays, Hit *hits, char *found, char *isLight, int *lightIdx, int n, double tmin) const {
+		group->intersectPacket(rays, hits, found, n, tmin);
+		for (int r = 0; r < n; r++) {
+			isLight[r] = false;
+			for (int i = 0; i < numLights; i++) {
+				if (lights[i]->intersect(rays[r], hits[r], tmin)) {
+					isLight[r] = true;
+					lightIdx[r] = i;
+				}
+			}
+			found[r] |= isLight[r];
+			if (found[r]) hits[r].computeSurface(rays[r]);
 		}
-		return isLight | objIntersect;
 	}
 };
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "utils/image.hpp"
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+
+#define SNAPSHOT_QUEUE_SIZE 2 // Snapshots waiting to be written, the older ones are dropped past it
+
+/**
+ * @note: Writes progressive snapshots from a background thread, so that rendering goes on
+ * during the writes. A snapshot is taken every interval iterations, at most once per
+ * minSeconds. Files are written aside & renamed, so viewers never see a partial one.
+ */
+class SnapshotWriter {
+private:
+    std::string pattern; // Of the file name, every %d - the iteration, the rest is kept as is
+    int interval; // 0 - no snapshot
+    double minSeconds;
+
+    bool taken;
+    std::chrono::steady_clock::time_point last;
+
+    std::deque<std::pair<int, Image *>> queue;
+    std::mutex lock;
+    std::condition_variable ready;
+    bool stopping;
+    std::thread worker;
+
+    void write(int iteration, Image *image) {
+        // Substituted by hand, the pattern comes from the user & is no format string
+        std::string filename = this->pattern, number = std::to_string(iteration);
+        for (size_t at = filename.find("%d"); at != std::string::npos; at = filename.find("%d", at + number.size()))
+            filename.replace(at, 2, number);
+        std::string partial = filename + ".part";
+
+        if (!image->saveBMP(partial.c_str()) || std::rename(partial.c_str(), filename.c_str()) != 0)
+            printf("Cannot write snapshot %s\n", filename.c_str());
+        delete image;
+    }
+
+    void loop() {
+        while (true) {
+            std::pair<int, Image *> item;
+            {
+                std::unique_lock<std::mutex> guard(this->lock);
+                this->ready.wait(guard, [this] { return this->stopping || !this->queue.empty(); });
+                if (this->queue.empty()) return; // Stopping & nothing left
+                item = this->queue.front();
+                this->queue.pop_front();
+            }
+            this->write(item.first, item.second);
+        }
+    }
+
+public:
+    SnapshotWriter(const std::string &_pattern, int _interval, double _minSeconds)
+        : pattern(_pattern), interval(_interval), minSeconds(_minSeconds), taken(false), stopping(false) {
+        if (this->interval > 0)
+            this->worker = std::thread(&SnapshotWriter::loop, this);
+    }
+
+    // Writes the snapshots left in the queue
+    ~SnapshotWriter() {
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->stopping = true;
+        }
+        this->ready.notify_one();
+        if (this->worker.joinable()) this->worker.join();
+    }
+
+    // Whether the caller should build a snapshot of this iteration
+    bool due(int iteration) {
+        if (this->interval <= 0 || (iteration + 1) % this->interval != 0) return false;
+
+        auto now = std::chrono::steady_clock::now();
+        if (this->taken && std::chrono::duration<double>(now - this->last).count() < this->minSeconds)
+            return false;
+        this->taken = true;
+        this->last = now;
+        return true;
+    }
+
+    // Takes the ownership of image
+    void push(int iteration, Image *image) {
+        Image *dropped = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            if ((int) this->queue.size() >= SNAPSHOT_QUEUE_SIZE) {
+                dropped = this->queue.front().second;
+                this->queue.pop_front();
+            }
+            this->queue.push_back(std::make_pair(iteration, image));
+        }
+        this->ready.notify_one();
+        if (dropped) delete dropped;
+    }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <cstdint>
+#include <algorithm>
+#include <omp.h>
+
+#define TILE_SIZE 32
+
+// Pixels [x0, x1) x [y0, y1) of the image
+struct Tile {
+    int x0, y0;
+    int x1, y1;
+};
+
+/**
+ * @note: Splits the image into square tiles, ordered along a Morton curve so that
+ * consecutive tiles are close to each other. Every thread starts with a contiguous
+ * run of tiles in its own deque, & steals from the back of the others once empty.
+ */
+class TileScheduler {
+private:
+    std::vector<Tile> tiles;
+
+    // Bits of v spread to the even positions
+    static uint32_t spread(uint32_t v) {
+        v &= 0xffff;
+        v = (v | (v << 8)) & 0x00ff00ff;
+        v = (v | (v << 4)) & 0x0f0f0f0f;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    }
+
+public:
+    TileScheduler(int width, int height, int size = TILE_SIZE) {
+        std::vector<std::pair<uint32_t, Tile>> order;
+        for (int ty = 0; ty * size < height; ty++)
+            for (int tx = 0; tx * size < width; tx++) {
+                Tile tile { tx * size, ty * size, std::min(width, (tx + 1) * size), std::min(height, (ty + 1) * size) };
+                order.push_back(std::make_pair(spread(tx) | (spread(ty) << 1), tile));
+            }
+        std::sort(order.begin(), order.end(), [](const std::pair<uint32_t, Tile> &a, const std::pair<uint32_t, Tile> &b) {
+            return a.first < b.first;
+        });
+
+        for (auto &p : order)
+            this->tiles.push_back(p.second);
+    }
+
+    int getTileNum() const { return this->tiles.size(); }
+
+    // Calls func(tile, thread) once for every tile, in parallel
+    template <typename Func>
+    void run(Func func) const {
+        int threadNum = omp_get_max_threads();
+        int tileNum = this->tiles.size();
+        std::vector<std::deque<int>> queues(threadNum);
+        std::vector<std::mutex> locks(threadNum);
+        for (int t = 0; t < tileNum; t++)
+            queues[(int64_t) t * threadNum / tileNum].push_back(t);
+
+#pragma omp parallel num_threads(threadNum)
+        {
+            int thread = omp_get_thread_num();
+            while (true) {
+                // Own tiles from the front, stolen ones from the back, far from the owner's
+                int tile = -1;
+                for (int k = 0; k < threadNum && tile < 0; k++) {
+                    int victim = (thread + k) % threadNum;
+                    std::lock_guard<std::mutex> guard(locks[victim]);
+                    if (queues[victim].empty()) continue;
+                    if (k == 0) {
+                        tile = queues[victim].front();
+                        queues[victim].pop_front();
+                    } else {
+                        tile = queues[victim].back();
+                        queues[victim].pop_back();
+                    }
+                }
+                if (tile < 0) break; // No tile is ever added, so all of them are taken
+                func(this->tiles[tile], thread);
+            }
+        }
+    }
+};
@@ -1,14 +1,38 @@
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
 
 #include "utils/scene_parser.hpp"
 #include "utils/image.hpp"
 #include "renderer/renderer.hpp"
+#include "renderer/path_tracer.hpp"
+#include "renderer/vcm.hpp"
 #include "renderer/camera.hpp"
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        std::cout << "Usage: ./bin/NAIVE_RAY_TRACER <input scene file> <output bmp file>" << std::endl;
+    if (argc < 3) {
+        std::cout << "Usage: ./bin/NAIVE_RAY_TRACER <input scene file> <output bmp file> [options]" << std::endl;
+        std::cout << "Options:" << std::endl;
+        std::cout << "  --integrator <type>           sppm (default), path or vcm" << std::endl;
+        std::cout << "  --spp <n>                     Samples per pixel of the path tracer & vcm (default 64)" << std::endl;
+        std::cout << "  --adaptive-emission <grid>    Guide photon emission by eye pass visibility" << std::endl;
+        std::cout << "  --photon-cache <file>         Reuse photon maps across renders of the same scene" << std::endl;
+        std::cout << "  --photon-sampler <type>       random, halton or sobol (default)" << std::endl;
+        std::cout << "  --caustic-splat               Light trace the caustics seen by the camera" << std::endl;
+        std::cout << "  --final-gather <rays>         Gather the photon map one bounce away, through an irradiance cache" << std::endl;
+        std::cout << "  --adaptive <threshold>        Retire pixels whose relative error is below threshold" << std::endl;
+        std::cout << "  --snapshots <pattern> <every> Save every n iterations into pattern, %d the iteration (default tmp/%d.test.bmp 1), 0 disables" << std::endl;
+        std::cout << "  --snapshot-seconds <s>        Save snapshots at most once per s seconds" << std::endl;
+        std::cout << "  --checkpoint <file> <every>   Save the render state every n iterations & when interrupted" << std::endl;
+        std::cout << "  --resume                      Go on from the checkpoint file when it matches the render" << std::endl;
+        std::cout << "  --time-budget <seconds>       Render until the time is up instead of a fixed iteration count" << std::endl;
+        std::cout << "  --scale-photons               Cut the photons per iteration when few iterations fit in the time budget" << std::endl;
+        std::cout << "  --wavefront                   Trace the eye & photon passes bounce by bounce over ray queues" << std::endl;
+        std::cout << "  --guiding                     Learn & sample the incident radiance in the path tracer (experimental)" << std::endl;
+        std::cout << "  --pixel-sampler <type>        random (default), stratified, sobol or bluenoise" << std::endl;
+        std::cout << "  --roulette <depth> <minq>     Russian roulette after depth bounces (off by default, e.g. 3 0.05)" << std::endl;
         return 1;
     }
 
@@ -18,10 +42,137 @@ int main(int argc, char *argv[]) {
     SceneParser parser(inputFile.c_str());
     Camera *camera = parser.getCamera();
     Image img(camera->getWidth(), camera->getHeight());
-    SPPMRenderer renderer(400000, 400, 100, 16, 0.5, 0.75);
 
-    renderer.render(parser, img);
+    // The integrator is picked first, the other options are applied to it
+    std::string integrator = "sppm";
+    int spp = 64;
+    for (int i = 3; i + 1 < argc; i++) {
+        if (!strcmp(argv[i], "--integrator"))
+            integrator = argv[i + 1];
+        else if (!strcmp(argv[i], "--spp"))
+            spp = std::max(1, atoi(argv[i + 1]));
+    }
+
+    Integrator *renderer;
+    SPPMRenderer *sppm = nullptr;
+    PathTracer *path = nullptr;
+    if (integrator == "sppm") {
+        renderer = sppm = new SPPMRenderer(400000, 400, 100, 16, 0.5, 0.75);
+    } else if (integrator == "path") {
+        renderer = path = new PathTracer(spp, 100);
+    } else if (integrator == "vcm") {
+        renderer = new VCMIntegrator(spp, 100, 0.05, 0.75);
+    } else {
+        std::cout << "Unknown integrator: " << integrator << std::endl;
+        return 1;
+    }
+
+    std::string snapshotPattern = "tmp/%d.test.bmp";
+    int snapshotInterval = 1;
+    double snapshotSeconds = 0.;
+    std::string checkpointFile;
+    int checkpointInterval = 10;
+    bool resume = false;
+    double timeBudget = 0.;
+    bool scalePhotons = false;
+    for (int i = 3; i < argc; i++) {
+        bool photonOption =
+            !strcmp(argv[i], "--adaptive-emission") ||
+            !strcmp(argv[i], "--photon-cache") ||
+            !strcmp(argv[i], "--photon-sampler") ||
+            !strcmp(argv[i], "--caustic-splat") ||
+            !strcmp(argv[i], "--final-gather") ||
+            !strcmp(argv[i], "--adaptive") ||
+            !strcmp(argv[i], "--snapshots") ||
+            !strcmp(argv[i], "--snapshot-seconds") ||
+            !strcmp(argv[i], "--checkpoint") ||
+            !strcmp(argv[i], "--resume") ||
+            !strcmp(argv[i], "--time-budget") ||
+            !strcmp(argv[i], "--scale-photons") ||
+            !strcmp(argv[i], "--wavefront");
+        if (photonOption && !sppm) {
+            std::cout << "Option " << argv[i] << " only applies to sppm" << std::endl;
+            return 1;
+        }
+        if (!strcmp(argv[i], "--guiding") && !path) {
+            std::cout << "Option " << argv[i] << " only applies to path" << std::endl;
+            return 1;
+        }
+
+        if ((!strcmp(argv[i], "--integrator") || !strcmp(argv[i], "--spp")) && i + 1 < argc) {
+            i++;
+        } else if (!strcmp(argv[i], "--adaptive-emission") && i + 1 < argc) {
+            sppm->setAdaptiveEmission(atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--photon-cache") && i + 1 < argc) {
+            sppm->setPhotonCache(argv[++i]);
+        } else if (!strcmp(argv[i], "--guiding")) {
+            path->setPathGuiding(true);
+        } else if (!strcmp(argv[i], "--caustic-splat")) {
+            sppm->setCausticSplat(true);
+        } else if (!strcmp(argv[i], "--final-gather") && i + 1 < argc) {
+            sppm->setFinalGather(atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--adaptive") && i + 1 < argc) {
+            sppm->setAdaptiveSampling(atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--snapshots") && i + 2 < argc) {
+            snapshotPattern = argv[++i];
+            snapshotInterval = atoi(argv[++i]);
+            sppm->setSnapshots(snapshotPattern, snapshotInterval, snapshotSeconds);
+        } else if (!strcmp(argv[i], "--snapshot-seconds") && i + 1 < argc) {
+            snapshotSeconds = atof(argv[++i]);
+            sppm->setSnapshots(snapshotPattern, snapshotInterval, snapshotSeconds);
+        } else if (!strcmp(argv[i], "--checkpoint") && i + 2 < argc) {
+            checkpointFile = argv[++i];
+            checkpointInterval = atoi(argv[++i]);
+            sppm->setCheckpoint(checkpointFile, checkpointInterval, resume);
+        } else if (!strcmp(argv[i], "--resume")) {
+            resume = true;
+            sppm->setCheckpoint(checkpointFile, checkpointInterval, resume);
+        } else if (!strcmp(argv[i], "--time-budget") && i + 1 < argc) {
+            timeBudget = atof(argv[++i]);
+            sppm->setTimeBudget(timeBudget, scalePhotons);
+        } else if (!strcmp(argv[i], "--scale-photons")) {
+            scalePhotons = true;
+            sppm->setTimeBudget(timeBudget, scalePhotons);
+        } else if (!strcmp(argv[i], "--wavefront")) {
+            sppm->setWavefront(true);
+        } else if (!strcmp(argv[i], "--photon-sampler") && i + 1 < argc) {
+            std::string type = argv[++i];
+            if (type == "random")
+                sppm->setPhotonSampler(SAMPLER_RANDOM);
+            else if (type == "halton")
+                sppm->setPhotonSampler(SAMPLER_HALTON);
+            else if (type == "sobol")
+                sppm->setPhotonSampler(SAMPLER_SOBOL);
+            else {
+                std::cout << "Unknown sampler: " << type << std::endl;
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--roulette") && i + 2 < argc) {
+            int startDepth = atoi(argv[++i]);
+            renderer->setRussianRoulette(startDepth, atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--pixel-sampler") && i + 1 < argc) {
+            std::string type = argv[++i];
+            if (type == "random")
+                renderer->setPixelSampler(PIXEL_SAMPLER_RANDOM);
+            else if (type == "stratified")
+                renderer->setPixelSampler(PIXEL_SAMPLER_STRATIFIED);
+            else if (type == "sobol")
+                renderer->setPixelSampler(PIXEL_SAMPLER_SOBOL);
+            else if (type == "bluenoise")
+                renderer->setPixelSampler(PIXEL_SAMPLER_BLUE_NOISE);
+            else {
+                std::cout << "Unknown sampler: " << type << std::endl;
+                return 1;
+            }
+        } else {
+            std::cout << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    renderer->render(parser, img);
     img.saveBMP(outputFile.c_str());
+    delete renderer;
 
     return 0;
-}
\ No newline at end of file
+}
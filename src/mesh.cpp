@@ -14,7 +14,7 @@ Mesh::Mesh(const char *filename, Material *material) {
     Vector3f max(-INFINITY, -INFINITY, -INFINITY);
     Vector3f min(INFINITY, INFINITY, INFINITY);
 
-    Material *curMaterial = this->material;
+    Material *curMaterial = material; // Shared with the scene, not owned
     while (true) {
         std::getline(f, line);
         if (f.eof())
@@ -37,7 +37,7 @@ Mesh::Mesh(const char *filename, Material *material) {
             if (materialMap.count(name))
                 curMaterial = materialMap[name];
             else
-                curMaterial = this->material;
+                curMaterial = material;
         } else if (tok == "v") {
             Vector3f vec;
             ss >> vec[0] >> vec[1] >> vec[2];
@@ -58,7 +58,7 @@ Mesh::Mesh(const char *filename, Material *material) {
             normals.push_back(norm);
         } else if (tok == "f") {
             std::string token[3];
-            TriangleInfo info;
+            TriangleInfo info = TriangleInfo();
             ss >> token[0] >> token[1] >> token[2];
             for (int i = 0; i < 3; i++) {
                 std::istringstream iss(token[i]);
@@ -92,6 +92,8 @@ Mesh::Mesh(const char *filename, Material *material) {
 Mesh::~Mesh() {
     if (tree)
         delete tree;
+    for (auto &entry : materialMap) // Of the material libraries, unlike the scene ones
+        delete entry.second;
 }
 
 void Mesh::parseMTL(const char *filename) {
@@ -195,7 +197,25 @@ bool Mesh::intersect(const Ray &r, Hit &h, double tmin) const {
     return tree->intersect(this, r, h, tmin);
 }
 
-std::pair<HitSurface, double> Mesh::samplePoint(RandomEngine &reng) const {
+void Mesh::computeSurface(const Ray &r, Hit &h) const {
+    const TriangleInfo &info = triangles[h.primitive];
+    Vector3f v[3], normal[3];
+    Vector2f cord[3];
+    for (int i = 0; i < 3; i++)
+        v[i] = vertices[info.vId[i]];
+    Vector3f geoNormal = Vector3f::cross(v[1] - v[0], v[2] - v[0]).normalized();
+    for (int i = 0; i < 3; i++) {
+        normal[i] = info.validNormal ? normals[info.nId[i]] : geoNormal;
+        if (info.textured) cord[i] = cords[info.cordId[i]];
+    }
+    h.surface = Triangle::faceSurface(r.at(h.t), h.u, h.v, normal, geoNormal, cord, info.textured, info.material);
+}
+
+void Mesh::intersectPacket(const Ray *rays, Hit *hits, char *found, int n, double tmin) const {
+    tree->intersectPacket(this, rays, hits, found, n, tmin);
+}
+
+std::pair<HitSurface, double> Mesh::samplePoint(Sampler &reng) const {
     int triangleNum = triangles.size();
     int id = reng.getUniformInt(0, triangleNum - 1);
 
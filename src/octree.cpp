@@ -1,7 +1,29 @@
 #include "utils/octree.h"
 #include "geometry/mesh.h"
 
+// Face of the mesh, only what the intersection needs, see Mesh::computeSurface for the rest
+struct MeshFace {
+    const Mesh *mesh;
+    int id;
+    Vector3f vertices[3];
+
+    MeshFace(const Mesh *_mesh, int _id) : mesh(_mesh), id(_id) {
+        const TriangleInfo &info = mesh->triangles[id];
+        for (int i = 0; i < 3; i++)
+            this->vertices[i] = mesh->vertices[info.vId[i]];
+    }
+
+    bool intersect(const Ray &r, Hit &h, double tmin) const {
+        double t, beta, gamma;
+        if (!Triangle::intersectFace(r, tmin, h.t, vertices, t, beta, gamma)) return false;
+        h.record(t, mesh->triangles[id].material, mesh, id, beta, gamma);
+        return true;
+    }
+};
+
 void Octree::release(OctNode *n) {
+    if (n == nullptr)
+        return;
     delete n->bbox;
     if (!n->leaf)
         for (int i = 0; i < 8; ++i)
@@ -27,21 +49,24 @@ OctNode *Octree::build(Mesh *mesh, BBox *bbox, const std::vector<int> &ids, int
     }
 
     // Otherwise, we need continue dividing
+    BBox *children[8];
+    for (int i = 0; i < 8; ++i)
+        children[i] = bbox->getChild(i);
     std::vector<int> splitIds[8];
     for (int id : ids) {
         const TriangleInfo &info = mesh->triangles[id];
         auto &vList = mesh->vertices;
 
         for (int i = 0; i < 8; ++i) {
-            if (bbox->getChild(i)->triIntersectBox(
+            if (children[i]->triIntersectBox(
                     vList[info.vId[0]], vList[info.vId[1]], vList[info.vId[2]]))
-                splitIds[i].push_back(i);
+                splitIds[i].push_back(id);
         }
     }
 
     // Recursive
     for (int i = 0; i < 8; i++)
-        now->child[i] = build(mesh, bbox->getChild(i), splitIds[i], depth + 1);
+        now->child[i] = build(mesh, children[i], splitIds[i], depth + 1);
     now->leaf = false;
     return now;
 }
@@ -52,25 +77,8 @@ bool Octree::traverseIntersect(const Mesh *mesh, OctNode *node, const Ray &r, Hi
 
     if (node->leaf) {
         bool result = false;
-        for (int id : node->faceIds) {
-            auto &info = mesh->triangles[id];
-            Triangle triangle(
-                mesh->vertices[info.vId[0]],
-                mesh->vertices[info.vId[1]],
-                mesh->vertices[info.vId[2]],
-                info.material);
-            if (info.validNormal)
-                triangle.setNormal(
-                    mesh->normals[info.nId[0]],
-                    mesh->normals[info.nId[1]],
-                    mesh->normals[info.nId[2]]);
-            if (info.textured)
-                triangle.setCord(
-                    mesh->cords[info.cordId[0]],
-                    mesh->cords[info.cordId[1]],
-                    mesh->cords[info.cordId[2]]);
-            result |= triangle.intersect(r, h, tmin);
-        }
+        for (int id : node->faceIds)
+            result |= MeshFace(mesh, id).intersect(r, h, tmin);
         return result;
     }
 
@@ -87,7 +95,7 @@ bool Octree::traverseIntersect(const Mesh *mesh, OctNode *node, const Ray &r, Hi
     bool result = false;
     for (auto &p : tList) {
         result |= traverseIntersect(mesh, node->child[p.second], r, h, tmin);
-        if (result && node->child[p.second]->bbox->in(h.surface.position))
+        if (result && node->child[p.second]->bbox->in(r.at(h.t)))
             break;
     }
     return result;
@@ -112,4 +120,122 @@ bool Octree::intersect(const Mesh *mesh, const Ray &r, Hit &h, float tmin) const
     if (!traverseIntersect(mesh, this->root, r, h, tmin))
         return false;
     return true;
+}
+
+// Product of the intervals [a0, a1] & [b0, b1]
+static void intervalProduct(double a0, double a1, double b0, double b1, double &lo, double &hi) {
+    double p[4] = { a0 * b0, a0 * b1, a1 * b0, a1 * b1 };
+    lo = *std::min_element(p, p + 4);
+    hi = *std::max_element(p, p + 4);
+}
+
+bool Octree::packetMayHit(const OctNode *node, const PacketBounds &bounds, double tmin) const {
+    const Vector3f &llb = node->bbox->getLLB(), &urf = node->bbox->getURF();
+    double tNear = tmin, tFar = bounds.tMax;
+    for (int k = 0; k < 3; k++) {
+        if (bounds.sign[k] == 0) continue; // Mixed directions, no bound on this axis
+
+        // Entry & exit planes of the axis, the same for all the rays
+        double nearPlane = bounds.sign[k] > 0 ? llb[k] : urf[k];
+        double farPlane = bounds.sign[k] > 0 ? urf[k] : llb[k];
+        double lo, hi;
+        intervalProduct(nearPlane - bounds.oHi[k], nearPlane - bounds.oLo[k], bounds.invLo[k], bounds.invHi[k], lo, hi);
+        tNear = std::max(tNear, lo);
+        intervalProduct(farPlane - bounds.oHi[k], farPlane - bounds.oLo[k], bounds.invLo[k], bounds.invHi[k], lo, hi);
+        tFar = std::min(tFar, hi);
+    }
+    return tNear <= tFar + PACKET_EPSILON;
+}
+
+bool Octree::rayMayHit(const OctNode *node, const Ray &r, double tmin, double tmax) const {
+    const Vector3f &llb = node->bbox->getLLB(), &urf = node->bbox->getURF();
+    double tNear = tmin, tFar = tmax;
+    for (int k = 0; k < 3; k++) {
+        if (r.d[k] == 0) {
+            if (r.o[k] < llb[k] - PACKET_EPSILON || r.o[k] > urf[k] + PACKET_EPSILON) return false;
+            continue;
+        }
+        double t0 = (llb[k] - PACKET_EPSILON - r.o[k]) / r.d[k];
+        double t1 = (urf[k] + PACKET_EPSILON - r.o[k]) / r.d[k];
+        tNear = std::max(tNear, std::min(t0, t1));
+        tFar = std::min(tFar, std::max(t0, t1));
+    }
+    return tNear <= tFar;
+}
+
+void Octree::traversePacket(
+    const Mesh *mesh, const OctNode *node, const Ray *rays, Hit *hits, char *found,
+    const int *active, int activeNum, PacketBounds bounds, float tmin, int *scratch, int n
+) const {
+    if (node == nullptr) return;
+    if (!this->packetMayHit(node, bounds, tmin)) return; // The whole packet misses
+
+    // Rays left in the node, kept in the part of scratch of its depth
+    int *alive = scratch;
+    int aliveNum = 0;
+    for (int i = 0; i < activeNum; i++)
+        if (this->rayMayHit(node, rays[active[i]], tmin, hits[active[i]].t))
+            alive[aliveNum++] = active[i];
+    if (aliveNum == 0) return;
+
+    // Diverged, the rays left go on alone
+    if (aliveNum < PACKET_MIN_RAYS) {
+        for (int i = 0; i < aliveNum; i++)
+            found[alive[i]] |= this->traverseIntersect(mesh, const_cast<OctNode *>(node), rays[alive[i]], hits[alive[i]], tmin);
+        return;
+    }
+
+    if (node->leaf) {
+        for (int id : node->faceIds) {
+            MeshFace face(mesh, id);
+            for (int i = 0; i < aliveNum; i++)
+                found[alive[i]] |= face.intersect(rays[alive[i]], hits[alive[i]], tmin);
+        }
+        return;
+    }
+
+    // Front to back along the directions of the packet, the closer hits cull the far nodes
+    int mask = 0;
+    for (int k = 0; k < 3; k++)
+        if (rays[alive[0]].d[k] < 0) mask |= 1 << (2 - k);
+    for (int i = 0; i < 8; i++) {
+        const OctNode *child = node->child[i ^ mask];
+        if (child == nullptr) continue;
+        this->traversePacket(mesh, child, rays, hits, found, alive, aliveNum, bounds, tmin, scratch + n, n);
+
+        bounds.tMax = 0.;
+        for (int j = 0; j < aliveNum; j++)
+            bounds.tMax = std::max(bounds.tMax, hits[alive[j]].t);
+    }
+}
+
+void Octree::intersectPacket(const Mesh *mesh, const Ray *rays, Hit *hits, char *found, int n, float tmin) const {
+    if (this->root == nullptr || n == 0) return;
+
+    // Bounds of the packet, computed once for all the nodes
+    PacketBounds bounds;
+    bounds.tMax = 0.;
+    for (int k = 0; k < 3; k++) {
+        bounds.oLo[k] = bounds.invLo[k] = INFINITY;
+        bounds.oHi[k] = bounds.invHi[k] = -INFINITY;
+        bounds.sign[k] = rays[0].d[k] > 0 ? 1 : rays[0].d[k] < 0 ? -1 : 0;
+    }
+    // The rays of the packet, then those left at each depth
+    std::vector<int> active(n * (MAX_TREE_DEPTH + 2));
+    for (int r = 0; r < n; r++) {
+        active[r] = r;
+        bounds.tMax = std::max(bounds.tMax, hits[r].t);
+        for (int k = 0; k < 3; k++) {
+            double d = rays[r].d[k];
+            if ((d > 0 ? 1 : d < 0 ? -1 : 0) != bounds.sign[k]) bounds.sign[k] = 0;
+            bounds.oLo[k] = std::min(bounds.oLo[k], (double) rays[r].o[k]);
+            bounds.oHi[k] = std::max(bounds.oHi[k], (double) rays[r].o[k]);
+            if (d != 0) {
+                bounds.invLo[k] = std::min(bounds.invLo[k], 1. / d);
+                bounds.invHi[k] = std::max(bounds.invHi[k], 1. / d);
+            }
+        }
+    }
+
+    this->traversePacket(mesh, this->root, rays, hits, found, active.data(), n, bounds, tmin, active.data() + n, n);
 }
\ No newline at end of file
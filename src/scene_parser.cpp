@@ -1,5 +1,9 @@
 #include "utils/scene_parser.hpp"
 
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
 #define degreesToRadians(x) ((M_PI * x) / 180.)
 
 SceneParser::SceneParser(const char *filename) {
@@ -31,8 +35,27 @@ SceneParser::SceneParser(const char *filename) {
 	fclose(file);
 	file = nullptr;
 
+	hashFile(filename);
+
 	if (numLights == 0)
 		printf("WARNING: No lights specified\n");
+
+	// Aim point lights at the geometry
+	auto hitScene = [this](const Ray &r) -> bool {
+		Hit h;
+		bool isLight;
+		int lightId;
+		return intersect(r, h, 1e-6, isLight, lightId);
+	};
+	for (int i = 0; i < numLights && group != nullptr; i++)
+		lights[i]->restrictEmission(hitScene);
+
+	std::vector<double> lightPower(numLights);
+	for (int i = 0; i < numLights; i++) {
+		Vector3f power = lights[i]->getPower();
+		lightPower[i] = (power[0] + power[1] + power[2]) / 3.;
+	}
+	lightTable = AliasTable(lightPower);
 }
 
 SceneParser::~SceneParser() {
@@ -71,6 +94,50 @@ void SceneParser::parseFile() {
 	}
 }
 
+void SceneParser::hashFile(const char *filename) {
+	std::ifstream f(filename);
+	std::string token;
+	sceneHash = Hash::OFFSET;
+	cameraHash = Hash::OFFSET;
+
+	while (f >> token) {
+		// Cameras do not change the photon pass, they are hashed apart
+		if (token == "PerspectiveCamera" || token == "LensCamera") {
+			do {
+				cameraHash = Hash::fnv1a(token.data(), token.size() + 1, cameraHash); // With its '\0', so "1 23" & "12 3" differ
+			} while (token != "}" && f >> token);
+			continue;
+		}
+
+		sceneHash = Hash::fnv1a(token.data(), token.size() + 1, sceneHash); // Same separator as the camera
+		if ((token == "obj_file" || token == "texture" || token == "map_Kd") && f >> token) {
+			sceneHash = Hash::fnv1a(token.data(), token.size() + 1, sceneHash);
+			sceneHash = hashContent(token, sceneHash, 0);
+		}
+	}
+}
+
+// Meshes name their material libraries, which name their textures, all read as Mesh does
+uint64_t SceneParser::hashContent(const std::string &path, uint64_t h, int depth) {
+	std::ifstream in(path, std::ios::binary);
+	std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	h = Hash::fnv1a(content.data(), content.size(), h);
+
+	bool obj = path.size() >= 4 && path.compare(path.size() - 4, 4, ".obj") == 0;
+	bool mtl = path.size() >= 4 && path.compare(path.size() - 4, 4, ".mtl") == 0;
+	if (depth >= 2 || !(obj || mtl)) return h; // Textures reference nothing
+
+	std::istringstream lines(content);
+	std::string line, tok, ref;
+	while (std::getline(lines, line)) {
+		std::istringstream ss(line);
+		if (!(ss >> tok >> ref)) continue;
+		if ((obj && tok == "mtllib") || (mtl && tok.substr(0, 3) == "map"))
+			h = hashContent(ref, h, depth + 1);
+	}
+	return h;
+}
+
 void SceneParser::parsePerspectiveCamera() {
 	char token[MAX_PARSER_TOKEN_LENGTH];
 
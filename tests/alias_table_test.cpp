@@ -0,0 +1,57 @@
+#include "check.hpp"
+#include "utils/alias_table.hpp"
+
+#include <cmath>
+#include <vector>
+
+// Midpoints of n equal strata of [0, 1), one per draw
+class GridSampler : public Sampler {
+private:
+    int n, i;
+
+public:
+    GridSampler(int _n) : n(_n), i(0) { }
+
+    virtual double getUniformDouble(double min, double max) override {
+        return min + (max - min) * (this->i++ + .5) / this->n;
+    }
+};
+
+// The frequencies over a fine grid of primary samples are the probabilities
+static bool samplesAsPdf(const AliasTable &table, const std::vector<double> &expected) {
+    const int draws = 1 << 16;
+    GridSampler sampler(draws);
+    std::vector<int> count(table.size(), 0);
+    for (int k = 0; k < draws; k++)
+        count[table.sample(sampler)]++;
+    for (int i = 0; i < table.size(); i++)
+        if (std::abs(table.getPdf(i) - expected[i]) > 1e-12 ||
+            std::abs((double) count[i] / draws - expected[i]) > 1e-3)
+            return false;
+    return true;
+}
+
+static void testWeights() {
+    CHECK(samplesAsPdf(AliasTable({ 1., 3., 4. }), { .125, .375, .5 }));
+    CHECK(samplesAsPdf(AliasTable({ 5. }), { 1. }));
+
+    // Zero & negative weights are never picked
+    CHECK(samplesAsPdf(AliasTable({ 2., 0., 6., -1. }), { .25, 0., .75, 0. }));
+
+    // Without any positive weight, uniform
+    CHECK(samplesAsPdf(AliasTable({ 0., 0. }), { .5, .5 }));
+
+    std::vector<double> weights, expected;
+    double total = 0.;
+    for (int i = 0; i < 100; i++) {
+        weights.push_back((i * 37) % 11);
+        total += weights.back();
+    }
+    for (double w : weights) expected.push_back(w / total);
+    CHECK(samplesAsPdf(AliasTable(weights), expected));
+}
+
+int main() {
+    testWeights();
+    return report();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdio>
+
+static int failures = 0;
+
+// Reports a failed condition & goes on, main returns the verdict
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+inline int report() {
+    if (failures > 0) printf("%d check(s) failed\n", failures);
+    return failures > 0 ? 1 : 0;
+}
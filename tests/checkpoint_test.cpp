@@ -0,0 +1,132 @@
+#include "check.hpp"
+#include "renderer/checkpoint.hpp"
+#include "utils/scene_parser.hpp"
+
+#include <fstream>
+#include <string>
+
+static RenderState makeState(int pixels) {
+    RenderState state;
+    state.nextIter = 0;
+    state.iterDone = 0;
+    state.searchRadius = 0.;
+    state.img.assign(pixels, Vector3f::ZERO);
+    state.splat.assign(3 * pixels, 0.);
+    state.budget.assign(pixels, 0);
+    state.sampleCount.assign(pixels, 0);
+    state.iterCount.assign(pixels, 0);
+    state.lumSum.assign(pixels, 0.);
+    state.lumSqSum.assign(pixels, 0.);
+    return state;
+}
+
+// Values a float holds exactly, so that the round trip is exact
+static RenderState filledState(int pixels) {
+    RenderState state = makeState(pixels);
+    state.nextIter = 7;
+    state.iterDone = 6;
+    state.searchRadius = 0.123456789;
+    for (int i = 0; i < pixels; i++) {
+        state.img[i] = Vector3f(i * .25, i * .5 + 1., -i * .125);
+        for (int k = 0; k < 3; k++)
+            state.splat[3 * i + k] = i + k * .0625;
+        state.budget[i] = i % 4 + 1;
+        state.sampleCount[i] = 10 * i;
+        state.iterCount[i] = i / 2;
+        state.lumSum[i] = i * .75;
+        state.lumSqSum[i] = i * i * .5;
+    }
+    return state;
+}
+
+static bool sameState(const RenderState &a, const RenderState &b) {
+    if (a.nextIter != b.nextIter || a.iterDone != b.iterDone || a.searchRadius != b.searchRadius)
+        return false;
+    for (size_t i = 0; i < a.img.size(); i++)
+        for (int k = 0; k < 3; k++)
+            if (a.img[i][k] != b.img[i][k]) return false;
+    return a.splat == b.splat && a.budget == b.budget && a.sampleCount == b.sampleCount &&
+        a.iterCount == b.iterCount && a.lumSum == b.lumSum && a.lumSqSum == b.lumSqSum;
+}
+
+static void testRoundTrip() {
+    const int pixels = 37;
+    const char *file = "checkpoint_test.ckpt";
+    RenderState saved = filledState(pixels);
+    CHECK(Checkpoint::save(file, 42, saved));
+
+    RenderState loaded = makeState(pixels);
+    CHECK(Checkpoint::load(file, 42, loaded));
+    CHECK(sameState(saved, loaded));
+
+    // Another render or image size is refused & leaves the state alone
+    RenderState other = makeState(pixels);
+    CHECK(!Checkpoint::load(file, 43, other));
+    CHECK(sameState(other, makeState(pixels)));
+    RenderState smaller = makeState(pixels - 1);
+    CHECK(!Checkpoint::load(file, 42, smaller));
+
+    // So is a truncated file
+    std::string content;
+    {
+        std::ifstream in(file, std::ios::binary);
+        content.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(file, std::ios::binary);
+        out.write(content.data(), content.size() - 4);
+    }
+    RenderState truncated = makeState(pixels);
+    CHECK(!Checkpoint::load(file, 42, truncated));
+    CHECK(sameState(truncated, makeState(pixels)));
+
+    std::remove(file);
+}
+
+static void writeScene(const char *file, const char *center, const char *light = "0 1 0") {
+    std::ofstream out(file);
+    out << "PerspectiveCamera {\n"
+        << "    center " << center << "\n"
+        << "    direction 0 0 -1\n    up 0 1 0\n    angle 60\n    width 8\n    height 6\n    gamma 2.2\n}\n"
+        << "Background {\n    color 0 0 0\n    ambient 0 0 0\n}\n"
+        << "Lights {\n    numLights 1\n    PointLight {\n        position " << light << "\n        power 1 1 1\n    }\n}\n"
+        << "Materials {\n    numMaterials 1\n    LambertMaterial {\n        color 0.8 0.8 0.8\n    }\n}\n"
+        << "Group {\n    numObjects 1\n    MaterialIndex 0\n    Plane {\n        normal 0 1 0\n        offset -2\n    }\n}\n";
+}
+
+// Checkpoints are keyed on the camera too, the photon cache on the rest only
+static void testSceneKeys() {
+    writeScene("checkpoint_test_a.txt", "0 0 5");
+    writeScene("checkpoint_test_b.txt", "0 0.5 5");
+    writeScene("checkpoint_test_c.txt", "0 0 5");
+    SceneParser *a = new SceneParser("checkpoint_test_a.txt");
+    SceneParser *b = new SceneParser("checkpoint_test_b.txt");
+    SceneParser *c = new SceneParser("checkpoint_test_c.txt");
+
+    CHECK(a->getHash() == b->getHash());
+    CHECK(a->getCameraHash() != b->getCameraHash());
+    CHECK(a->getHash() == c->getHash());
+    CHECK(a->getCameraHash() == c->getCameraHash());
+
+    // Tokens are hashed apart, "0 11 0" is not "01 1 0"
+    writeScene("checkpoint_test_b.txt", "0 0 5", "0 11 0");
+    writeScene("checkpoint_test_c.txt", "0 0 5", "01 1 0");
+    delete b;
+    delete c;
+    b = new SceneParser("checkpoint_test_b.txt");
+    c = new SceneParser("checkpoint_test_c.txt");
+    CHECK(b->getHash() != c->getHash());
+
+    delete a;
+    delete b;
+    delete c;
+    std::remove("checkpoint_test_a.txt");
+    std::remove("checkpoint_test_b.txt");
+    std::remove("checkpoint_test_c.txt");
+}
+
+int main() {
+    testRoundTrip();
+    testSceneKeys();
+    return report();
+}
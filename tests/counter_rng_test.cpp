@@ -0,0 +1,56 @@
+#include "check.hpp"
+#include "utils/counter_rng.hpp"
+
+static bool generates(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3, uint32_t k0, uint32_t k1,
+                      uint32_t o0, uint32_t o1, uint32_t o2, uint32_t o3) {
+    uint32_t ctr[4] = { c0, c1, c2, c3 }, key[2] = { k0, k1 }, out[4];
+    Philox::generate(ctr, key, out);
+    return out[0] == o0 && out[1] == o1 && out[2] == o2 && out[3] == o3;
+}
+
+// Known answers of Philox4x32-10 from the Random123 distribution
+static void testKnownAnswers() {
+    CHECK(generates(0, 0, 0, 0, 0, 0,
+        0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8));
+    CHECK(generates(0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff,
+        0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd));
+    CHECK(generates(0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344, 0xa4093822, 0x299f31d0,
+        0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1));
+}
+
+// A value only depends on the stream & the dimension, not on what was drawn before
+static void testStreams() {
+    CounterSampler a(3), b(3), c(4);
+    a.startStream(1, 2, 3, 4);
+    double first[16];
+    for (int d = 0; d < 16; d++) {
+        first[d] = a.getUniformDouble(0, 1);
+        CHECK(first[d] >= 0. && first[d] < 1.);
+    }
+
+    b.startStream(9, 9, 9, 9);
+    b.getUniformDouble(0, 1);
+    b.startStream(1, 2, 3, 4);
+    for (int d = 15; d >= 0; d--) {
+        b.setDimension(d);
+        CHECK(b.getUniformDouble(0, 1) == first[d]);
+    }
+
+    // Another seed, iteration or stream gives other numbers
+    c.startStream(1, 2, 3, 4);
+    CHECK(c.getUniformDouble(0, 1) != first[0]);
+    b.startStream(2, 2, 3, 4);
+    CHECK(b.getUniformDouble(0, 1) != first[0]);
+    b.startStream(1, 2, 3, 5);
+    CHECK(b.getUniformDouble(0, 1) != first[0]);
+
+    b.startStream(1, 2, 3, 4);
+    b.setDimension(5);
+    CHECK(b.getUniformDouble(2, 4) == 2 + 2 * first[5]);
+}
+
+int main() {
+    testKnownAnswers();
+    testStreams();
+    return report();
+}
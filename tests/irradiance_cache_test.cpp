@@ -0,0 +1,89 @@
+#include "check.hpp"
+#include "photon/irradiance_cache.hpp"
+#include "utils/random_engine.hpp"
+
+#include <cmath>
+#include <vector>
+
+struct Record {
+    Vector3f position, normal, irradiance;
+    double radius;
+};
+
+// Lookup over every record, with the weights of the cache
+static bool bruteForce(const std::vector<Record> &records, double accuracy, const Vector3f &p, const Vector3f &n, Vector3f &irradiance) {
+    Vector3f sum = Vector3f::ZERO;
+    double weightSum = 0.;
+    for (const Record &r : records) {
+        Vector3f d = p - r.position;
+        if (Vector3f::dot(d, r.normal + n) < -.02 * r.radius) continue;
+        double error = d.length() / r.radius + std::sqrt(std::max(0., 1. - (double) Vector3f::dot(n, r.normal)));
+        double weight = 1. / std::max(error, 1e-6);
+        if (weight <= 1. / accuracy) continue;
+        sum += weight * r.irradiance;
+        weightSum += weight;
+    }
+    if (weightSum <= 0) return false;
+    irradiance = sum / weightSum;
+    return true;
+}
+
+static void testSingleRecord() {
+    IrradianceCache cache(.2, .01, 1.);
+    Vector3f e;
+    CHECK(!cache.lookup(Vector3f::ZERO, Vector3f(0, 0, 1), e));
+
+    cache.insert(Vector3f::ZERO, Vector3f(0, 0, 1), Vector3f(1, 2, 3), .5);
+    CHECK(cache.lookup(Vector3f(.05, 0, 0), Vector3f(0, 0, 1), e));
+    CHECK(e[0] == 1 && e[1] == 2 && e[2] == 3);
+
+    CHECK(!cache.lookup(Vector3f(1, 0, 0), Vector3f(0, 0, 1), e)); // Too far
+    CHECK(!cache.lookup(Vector3f::ZERO, Vector3f(0, 0, -1), e)); // Facing away
+    CHECK(!cache.lookup(Vector3f(0, 0, -.1), Vector3f(0, 0, 1), e)); // Behind the record
+}
+
+// The octree finds the same records as a scan, wherever the root had to grow
+static void testAgainstBruteForce() {
+    const double accuracy = 1.;
+    IrradianceCache cache(accuracy, .01, 10.);
+    std::vector<Record> records;
+    RandomEngine reng(1);
+    auto randomNormal = [&]() {
+        Vector3f n(reng.getUniformDouble(-1, 1), reng.getUniformDouble(-1, 1), 2.);
+        return n.normalized();
+    };
+
+    for (int i = 0; i < 500; i++) {
+        Record r;
+        r.position = Vector3f(reng.getUniformDouble(-20, 20), reng.getUniformDouble(-20, 20), reng.getUniformDouble(-1, 1));
+        r.normal = randomNormal();
+        r.irradiance = Vector3f(reng.getUniformDouble(0, 1), reng.getUniformDouble(0, 1), reng.getUniformDouble(0, 1));
+        r.radius = std::exp(reng.getUniformDouble(std::log(.05), std::log(5.)));
+        records.push_back(r);
+        cache.insert(r.position, r.normal, r.irradiance, r.radius);
+    }
+
+    int mismatches = 0, found = 0;
+    for (int i = 0; i < 2000; i++) {
+        // Around a record, so that most lookups find some
+        const Record &near = records[reng.getUniformInt(0, records.size() - 1)];
+        double spread = near.radius;
+        Vector3f p = near.position + Vector3f(
+            reng.getUniformDouble(-spread, spread), reng.getUniformDouble(-spread, spread), reng.getUniformDouble(-spread, spread));
+        Vector3f n = (near.normal + .2 * randomNormal()).normalized();
+        Vector3f a, b;
+        bool inCache = cache.lookup(p, n, a);
+        bool inScan = bruteForce(records, accuracy, p, n, b);
+        if (inCache != inScan || (inCache && (a - b).length() > 1e-9))
+            mismatches++;
+        found += inScan;
+    }
+    CHECK(mismatches == 0);
+    CHECK(found > 500); // Most lookups do reach records
+}
+
+int main() {
+    testSingleRecord();
+    testAgainstBruteForce();
+    return report();
+}
@@ -0,0 +1,101 @@
+#include "check.hpp"
+#include "photon/photon_cache.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Values a float holds exactly, so that the round trip is exact
+static std::vector<Photon> makePhotons(int n, int seed) {
+    std::vector<Photon> photons(n);
+    for (int i = 0; i < n; i++) {
+        double x = seed + i * .25;
+        photons[i] = Photon {
+            Vector3f(x, -x, x * .5),
+            Vector3f(0, 1, 0),
+            Vector3f(.125 * i, .5, 1.),
+            i % 3 - 1,
+            i % 2 == 0,
+        };
+    }
+    return photons;
+}
+
+static bool samePhotons(const std::vector<Photon> &a, const std::vector<Photon> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++)
+        for (int k = 0; k < 3; k++)
+            if (a[i].pos[k] != b[i].pos[k] || a[i].direction[k] != b[i].direction[k] ||
+                a[i].power[k] != b[i].power[k] || a[i].source != b[i].source || a[i].caustic != b[i].caustic)
+                return false;
+    return true;
+}
+
+static void testRoundTrip() {
+    const char *file = "photon_cache_test.bin";
+    std::remove(file);
+    std::vector<Photon> first = makePhotons(50, 0), second = makePhotons(31, 100);
+    {
+        PhotonCache cache(file, 7);
+        std::vector<Photon> loaded;
+        CHECK(!cache.load(0, loaded));
+        cache.store(0, first);
+        cache.store(2, second); // Not right after the last one, ignored
+        cache.store(1, second);
+    }
+
+    // Caustic flags included
+    {
+        PhotonCache cache(file, 7);
+        std::vector<Photon> loaded;
+        CHECK(cache.load(0, loaded));
+        CHECK(samePhotons(first, loaded));
+        CHECK(cache.load(1, loaded));
+        CHECK(samePhotons(second, loaded));
+        CHECK(!cache.load(2, loaded));
+    }
+
+    // A truncated tail is dropped, the iterations before it are kept
+    std::string content;
+    {
+        std::ifstream in(file, std::ios::binary);
+        content.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(file, std::ios::binary);
+        out.write(content.data(), content.size() - sizeof(PhotonRecord) / 2);
+    }
+    {
+        PhotonCache cache(file, 7);
+        std::vector<Photon> loaded;
+        CHECK(cache.load(0, loaded));
+        CHECK(samePhotons(first, loaded));
+        CHECK(!cache.load(1, loaded));
+        cache.store(1, second); // Appends where the valid part ends
+    }
+    {
+        PhotonCache cache(file, 7);
+        std::vector<Photon> loaded;
+        CHECK(cache.load(1, loaded));
+        CHECK(samePhotons(second, loaded));
+    }
+
+    // Another scene rebuilds the cache
+    {
+        PhotonCache cache(file, 8);
+        std::vector<Photon> loaded;
+        CHECK(!cache.load(0, loaded));
+    }
+    {
+        PhotonCache cache(file, 7);
+        std::vector<Photon> loaded;
+        CHECK(!cache.load(0, loaded));
+    }
+
+    std::remove(file);
+}
+
+int main() {
+    testRoundTrip();
+    return report();
+}
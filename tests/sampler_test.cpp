@@ -0,0 +1,52 @@
+#include "check.hpp"
+#include "utils/sampler.hpp"
+
+#include <vector>
+
+/**
+ * @note: The first 2^m samples of a dimension pair form a (0, m, 2)-net: every
+ * elementary interval of area 2^-m, 2^a by 2^b cells with a + b = m, holds one of them.
+ */
+static bool isNet(uint32_t seed, int m, int pair) {
+    int n = 1 << m;
+    SobolSampler sampler(seed);
+    std::vector<double> x(n), y(n);
+    for (int i = 0; i < n; i++) {
+        sampler.startSample(i);
+        sampler.setDimension(2 * pair);
+        x[i] = sampler.getUniformDouble(0, 1);
+        y[i] = sampler.getUniformDouble(0, 1);
+    }
+
+    for (int a = 0; a <= m; a++) {
+        int cols = 1 << a, rows = 1 << (m - a);
+        std::vector<int> count(n, 0);
+        for (int i = 0; i < n; i++)
+            count[(int) (y[i] * rows) * cols + (int) (x[i] * cols)]++;
+        for (int c : count)
+            if (c != 1) return false;
+    }
+    return true;
+}
+
+static void testSobolStratification() {
+    for (uint32_t seed = 0; seed < 4; seed++)
+        for (int m = 1; m <= 8; m++) {
+            CHECK(isNet(seed, m, 0));
+            CHECK(isNet(seed, m, 3));
+        }
+}
+
+// Scrambling changes the points, not their stratification
+static void testSobolSeeds() {
+    SobolSampler a(1), b(2);
+    a.startSample(5);
+    b.startSample(5);
+    CHECK(a.getUniformDouble(0, 1) != b.getUniformDouble(0, 1));
+}
+
+int main() {
+    testSobolStratification();
+    testSobolSeeds();
+    return report();
+}